@@ -0,0 +1,159 @@
+#!/usr/bin/env python3
+# Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+"""
+Measure how the Flybot dedicated server scales with player count by running headless bot clients
+against a local server. For each bot count, start a server on a generated map, start enough NullRHI
+bot clients to reach the count, let them play, then collect the ServerStats lines from the server log.
+
+Example:
+    Scripts/FlybotLoadTest.py --server Binaries/Linux/FlybotServer --client Binaries/Linux/Flybot
+"""
+
+import argparse
+import csv
+import os
+import re
+import subprocess
+import sys
+import time
+
+STATS_PATTERN = re.compile(r"ServerStats (.*)$")
+
+
+def start_server(args, bots, log_path):
+    # Each player start gets a room of its own, so generate twice as many rooms as bots to leave free
+    # rooms between the starts.
+    rooms = max(args.rooms, bots * 2)
+    # Turn off admission control, which would otherwise turn bots away once the server gets busy.
+    url = (f"{args.map}?GenerateMap?MapSeed={args.seed}?MapRooms={rooms}?MapPlayerStarts={bots}"
+           "?MaxServerFrameTime=0?MaxOutBytesPerConnection=0")
+    command = [args.server, url, f"-port={args.port}", "-log", f"-abslog={log_path}", "-unattended",
+               f"-ExecCmds=Flybot.ServerStatsInterval {args.interval}"]
+    return subprocess.Popen(command, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+
+
+def start_clients(args, bots, log_dir):
+    clients = []
+    for index, offset in enumerate(range(0, bots, args.bots_per_process)):
+        count = min(args.bots_per_process, bots - offset)
+        log_path = os.path.join(log_dir, f"Client{index}.log")
+        command = [args.client, f"127.0.0.1:{args.port}", "-game", "-nullrhi", "-nosound", "-unattended",
+                   "-FlybotBot", f"-FlybotBots={count}", f"-FlybotBotMode={args.mode}",
+                   f"-FlybotBotSeed={args.seed + offset}", "-log", f"-abslog={log_path}"]
+        clients.append(subprocess.Popen(command, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL))
+    return clients
+
+
+def stop(processes):
+    for process in processes:
+        process.terminate()
+    for process in processes:
+        try:
+            process.wait(timeout=30)
+        except subprocess.TimeoutExpired:
+            process.kill()
+
+
+def parse_stats(log_path, bots):
+    """
+    Return the reports taken after every bot joined, so the averages only cover full load, and the
+    most players seen in any report.
+    """
+    reports = []
+    max_players = 0
+    if not os.path.exists(log_path):
+        return reports, max_players
+
+    with open(log_path, errors="replace") as log:
+        for line in log:
+            match = STATS_PATTERN.search(line)
+            if not match:
+                continue
+            report = {}
+            for pair in match.group(1).split():
+                key, _, value = pair.partition("=")
+                report[key] = float(value)
+            max_players = max(max_players, int(report.get("Players", 0)))
+            if report.get("Players", 0) >= bots:
+                reports.append(report)
+    return reports, max_players
+
+
+def summarize(bots, reports, max_players):
+    if not reports:
+        return {"Bots": bots, "Players": max_players, "Reports": 0}
+
+    def average(key):
+        return sum(report[key] for report in reports) / len(reports)
+
+    return {
+        "Bots": bots,
+        "Players": max_players,
+        "Reports": len(reports),
+        "AvgFrameMs": round(average("AvgFrameMs"), 3),
+        "MaxFrameMs": round(max(report["MaxFrameMs"] for report in reports), 3),
+        "FrameRate": round(average("FrameRate"), 1),
+        "OutBytesPerConnection": round(average("OutBytesPerConnection")),
+        "InBytesPerConnection": round(average("InBytesPerConnection")),
+        "OutBytesPerPlayer": round(average("OutBytesPerPlayer")),
+        "CorrectionsPerSecond": round(average("CorrectionsPerSecond"), 2),
+    }
+
+
+def run(args, bots):
+    log_dir = os.path.abspath(os.path.join(args.output, f"Bots{bots}"))
+    os.makedirs(log_dir, exist_ok=True)
+    server_log = os.path.join(log_dir, "Server.log")
+
+    print(f"Running {bots} bots for {args.duration} seconds", flush=True)
+    server = start_server(args, bots, server_log)
+    time.sleep(args.server_startup)
+    clients = start_clients(args, bots, log_dir)
+    time.sleep(args.duration)
+    stop(clients)
+    stop([server])
+
+    reports, max_players = parse_stats(server_log, bots)
+    if max_players < bots:
+        print(f"Only {max_players} of {bots} bots joined, see {server_log}", file=sys.stderr, flush=True)
+    return summarize(bots, reports, max_players)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--server", required=True, help="Dedicated server binary")
+    parser.add_argument("--client", required=True, help="Client binary")
+    parser.add_argument("--map", default="/Game/Level", help="Map to load before generating rooms")
+    parser.add_argument("--bots", default="8,32,64,128", help="Comma separated bot counts to test")
+    parser.add_argument("--bots-per-process", type=int, default=8, help="Bots in each client process")
+    parser.add_argument("--mode", default="Random", choices=["Random", "Circle"], help="Bot input mode")
+    parser.add_argument("--duration", type=float, default=60, help="Seconds to run each bot count")
+    parser.add_argument("--server-startup", type=float, default=10, help="Seconds to wait for the server")
+    parser.add_argument("--interval", type=float, default=5, help="Seconds between server stats reports")
+    parser.add_argument("--rooms", type=int, default=64, help="Fewest rooms in the generated map")
+    parser.add_argument("--seed", type=int, default=1, help="Map and bot seed")
+    parser.add_argument("--port", type=int, default=7777, help="Server port")
+    parser.add_argument("--output", default="Saved/LoadTest", help="Directory for logs and results")
+    args = parser.parse_args()
+
+    results = [run(args, int(bots)) for bots in args.bots.split(",")]
+
+    fields = ["Bots", "Players", "Reports", "AvgFrameMs", "MaxFrameMs", "FrameRate", "OutBytesPerConnection",
+              "InBytesPerConnection", "OutBytesPerPlayer", "CorrectionsPerSecond"]
+    writer = csv.DictWriter(sys.stdout, fields, restval="")
+    writer.writeheader()
+    writer.writerows(results)
+
+    with open(os.path.join(args.output, "Results.csv"), "w", newline="") as output:
+        writer = csv.DictWriter(output, fields, restval="")
+        writer.writeheader()
+        writer.writerows(results)
+
+    # Results for fewer players than requested would be mistaken for the requested load.
+    if any(result["Players"] < result["Bots"] for result in results):
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
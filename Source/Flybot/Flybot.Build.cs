@@ -14,11 +14,15 @@ public class Flybot : ModuleRules
 			"Engine",
 			"EnhancedInput",
 			"InputCore",
+			"NetCore",
 			"Niagara",
 			"UMG"
 		});
 
-		PrivateDependencyModuleNames.AddRange(new string[] {  });
+		PrivateDependencyModuleNames.AddRange(new string[] {
+			"Json",
+			"ReplicationGraph"
+		});
 
 		// Uncomment if you are using Slate UI
 		// PrivateDependencyModuleNames.AddRange(new string[] { "Slate", "SlateCore" });
@@ -5,4 +5,6 @@
 
 DEFINE_LOG_CATEGORY(LogFlybot);
 
+DEFINE_STAT(STAT_FlybotShotHits);
+
 IMPLEMENT_PRIMARY_GAME_MODULE(FDefaultGameModuleImpl, Flybot, "Flybot");
\ No newline at end of file
@@ -3,5 +3,22 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
 
-DECLARE_LOG_CATEGORY_EXTERN(LogFlybot, All, All);
\ No newline at end of file
+DECLARE_LOG_CATEGORY_EXTERN(LogFlybot, All, All);
+
+DECLARE_STATS_GROUP(TEXT("Flybot"), STATGROUP_Flybot, STATCAT_Advanced);
+
+/** Shots that hit a pawn, from shot actors on clients and simulated shots on dedicated servers. */
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Shot Hits"), STAT_FlybotShotHits, STATGROUP_Flybot, FLYBOT_API);
+
+/**
+ * Time a scope with a cycle stat for stat Flybot. Cycle stats also show up as CPU trace scopes in
+ * Unreal Insights, but they are compiled out when STATS is off, such as in test builds, so use a
+ * trace scope with the stat name there instead.
+ */
+#if STATS
+#define FLYBOT_SCOPE_CYCLE_COUNTER(Stat) SCOPE_CYCLE_COUNTER(Stat)
+#else
+#define FLYBOT_SCOPE_CYCLE_COUNTER(Stat) TRACE_CPUPROFILER_EVENT_SCOPE(Stat)
+#endif
@@ -0,0 +1,135 @@
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+#include "FlybotAttributeComponent.h"
+#include "FlybotShot.h"
+#include "GameFramework/GameStateBase.h"
+#include "Net/Core/PushModel/PushModel.h"
+#include "Net/UnrealNetwork.h"
+
+FFlybotAttribute::FFlybotAttribute()
+{
+	BaseValue = 0.f;
+	Rate = 0.f;
+	BaseTime = 0.f;
+	Max = 0.f;
+}
+
+float FFlybotAttribute::GetValue(double Time) const
+{
+	// Skip the multiply for values that don't regenerate, such as health by default.
+	if (Rate == 0.f)
+		return BaseValue;
+
+	return FMath::Clamp(BaseValue + Rate * float(Time - BaseTime), 0.f, Max);
+}
+
+void FFlybotAttribute::SetValue(float Value, double Time)
+{
+	BaseValue = FMath::Clamp(Value, 0.f, Max);
+	BaseTime = float(Time);
+}
+
+UFlybotAttributeComponent::UFlybotAttributeComponent()
+{
+	MaxHealth = 25.f;
+	HealthRegenerateRate = 0.f;
+	MaxPower = 25.f;
+	PowerRegenerateRate = 1.f;
+	ShotPowerDelta = 0.f;
+
+	// Nothing changes per frame, values are computed when they are read.
+	PrimaryComponentTick.bCanEverTick = false;
+	SetIsReplicatedByDefault(true);
+}
+
+void UFlybotAttributeComponent::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	FDoRepLifetimeParams OwnerOnlyParams;
+	OwnerOnlyParams.bIsPushBased = true;
+	OwnerOnlyParams.Condition = COND_OwnerOnly;
+	DOREPLIFETIME_WITH_PARAMS_FAST(UFlybotAttributeComponent, Health, OwnerOnlyParams);
+}
+
+void UFlybotAttributeComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	// Replicated health may already have arrived on clients, so only the server fills it.
+	if (GetOwner()->HasAuthority())
+	{
+		InitAttribute(EFlybotAttribute::Health, MaxHealth, HealthRegenerateRate);
+	}
+	else
+	{
+		Health.Max = MaxHealth;
+	}
+
+	InitAttribute(EFlybotAttribute::Power, MaxPower, PowerRegenerateRate);
+}
+
+double UFlybotAttributeComponent::GetAttributeTime() const
+{
+	// Clients estimate the server time from the game state, so their values match the server's.
+	const UWorld* World = GetWorld();
+	const AGameStateBase* GameState = World->GetGameState();
+	return GameState ? GameState->GetServerWorldTimeSeconds() : World->GetTimeSeconds();
+}
+
+FFlybotAttribute& UFlybotAttributeComponent::GetAttribute(EFlybotAttribute Attribute)
+{
+	return Attribute == EFlybotAttribute::Health ? Health : Power;
+}
+
+const FFlybotAttribute& UFlybotAttributeComponent::GetAttribute(EFlybotAttribute Attribute) const
+{
+	return Attribute == EFlybotAttribute::Health ? Health : Power;
+}
+
+float UFlybotAttributeComponent::GetValue(EFlybotAttribute Attribute) const
+{
+	return GetAttribute(Attribute).GetValue(GetAttributeTime());
+}
+
+float UFlybotAttributeComponent::GetMax(EFlybotAttribute Attribute) const
+{
+	return GetAttribute(Attribute).Max;
+}
+
+float UFlybotAttributeComponent::ChangeValue(EFlybotAttribute Attribute, float Delta)
+{
+	double Time = GetAttributeTime();
+	FFlybotAttribute& Value = GetAttribute(Attribute);
+	Value.SetValue(Value.GetValue(Time) + Delta, Time);
+
+	if (Attribute == EFlybotAttribute::Health)
+	{
+		MARK_PROPERTY_DIRTY_FROM_NAME(UFlybotAttributeComponent, Health, this);
+	}
+
+	return Value.BaseValue;
+}
+
+void UFlybotAttributeComponent::InitAttribute(EFlybotAttribute Attribute, float Max, float Rate)
+{
+	FFlybotAttribute& Value = GetAttribute(Attribute);
+	Value.Max = Max;
+	Value.Rate = Rate;
+	Value.SetValue(Max, GetAttributeTime());
+
+	if (Attribute == EFlybotAttribute::Health)
+	{
+		MARK_PROPERTY_DIRTY_FROM_NAME(UFlybotAttributeComponent, Health, this);
+	}
+}
+
+void UFlybotAttributeComponent::SetShotClass(TSubclassOf<AFlybotShot> ShotClass)
+{
+	ShotPowerDelta = ShotClass ? ShotClass->GetDefaultObject<AFlybotShot>()->PowerDelta : 0.f;
+}
+
+bool UFlybotAttributeComponent::CanShoot() const
+{
+	return GetValue(EFlybotAttribute::Power) + ShotPowerDelta > 0.f;
+}
@@ -0,0 +1,128 @@
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "FlybotAttributeComponent.generated.h"
+
+/** Attributes held by UFlybotAttributeComponent. */
+UENUM()
+enum class EFlybotAttribute : uint8
+{
+	Health,
+	Power,
+	Num UMETA(Hidden)
+};
+
+/**
+ * A value that changes at a constant rate, stored as the value at a point in time instead of being
+ * advanced every frame. Times are server world times, so the server and clients compute the same
+ * value from the same replicated fields.
+ */
+USTRUCT()
+struct FLYBOT_API FFlybotAttribute
+{
+	GENERATED_BODY()
+
+	/** Value at BaseTime. */
+	UPROPERTY()
+	float BaseValue;
+
+	/** Change per second after BaseTime, 0 for values that only change when set. */
+	UPROPERTY()
+	float Rate;
+
+	/** Server world time BaseValue was set. */
+	UPROPERTY()
+	float BaseTime;
+
+	/** Largest value, from the component settings so it is never replicated. */
+	UPROPERTY(NotReplicated)
+	float Max;
+
+	FFlybotAttribute();
+
+	/** Value at a server world time, clamped between 0 and Max. */
+	float GetValue(double Time) const;
+
+	/** Set the value at a server world time, clamped between 0 and Max. */
+	void SetValue(float Value, double Time);
+};
+
+/**
+ * Health and power for a pawn. Regenerating values cost nothing per frame, they are only computed
+ * when read. Health is replicated to the owner with push model, power is simulated on every machine
+ * the same way shots are. The power cost of the pawn's shot class is cached so shooting doesn't look
+ * it up every frame.
+ */
+UCLASS()
+class FLYBOT_API UFlybotAttributeComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UFlybotAttributeComponent();
+
+	/** Setup properties that should be replicated from the server to clients. */
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+	/** Fill all attributes to their max, leaving replicated health alone on clients. */
+	virtual void BeginPlay() override;
+
+	/** Current value of an attribute. */
+	float GetValue(EFlybotAttribute Attribute) const;
+
+	/** Largest value of an attribute. */
+	float GetMax(EFlybotAttribute Attribute) const;
+
+	/** Change an attribute by Delta, returning the new value. Health should only be changed on the server. */
+	float ChangeValue(EFlybotAttribute Attribute, float Delta);
+
+	/** Set the max and regenerate rate of an attribute and fill it to the new max. */
+	void InitAttribute(EFlybotAttribute Attribute, float Max, float Rate);
+
+	/** Cache the power used by each shot of a shot class. */
+	void SetShotClass(TSubclassOf<class AFlybotShot> ShotClass);
+
+	/** Whether there is enough power left to fire the cached shot class. */
+	bool CanShoot() const;
+
+	/** Use the power for one shot of the cached shot class. */
+	void ConsumeShotPower() { ChangeValue(EFlybotAttribute::Power, ShotPowerDelta); }
+
+	/** Maximum amount of health to allow for player. */
+	UPROPERTY(EditAnywhere)
+	float MaxHealth;
+
+	/** How much health to regenerate every second. */
+	UPROPERTY(EditAnywhere)
+	float HealthRegenerateRate;
+
+	/** Maximum amount of power to allow for player. */
+	UPROPERTY(EditAnywhere)
+	float MaxPower;
+
+	/** How much power to regenerate every second. */
+	UPROPERTY(EditAnywhere)
+	float PowerRegenerateRate;
+
+private:
+	/** Server world time used for all attribute timestamps. */
+	double GetAttributeTime() const;
+
+	/** Storage for an attribute. */
+	FFlybotAttribute& GetAttribute(EFlybotAttribute Attribute);
+	const FFlybotAttribute& GetAttribute(EFlybotAttribute Attribute) const;
+
+	/** Current health of player, only replicated to the owner. */
+	UPROPERTY(Replicated)
+	FFlybotAttribute Health;
+
+	/** Current power of player, simulated locally. */
+	UPROPERTY()
+	FFlybotAttribute Power;
+
+	/** Power change for each shot of the cached shot class. */
+	float ShotPowerDelta;
+};
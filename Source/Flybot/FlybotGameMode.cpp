@@ -2,11 +2,24 @@
 
 #include "FlybotGameMode.h"
 #include "Flybot.h"
+#include "FlybotMapGenerator.h"
+#include "FlybotMapRoom.h"
+#include "FlybotServerStats.h"
 #include "EngineUtils.h"
 #include "GameFramework/PlayerStart.h"
+#include "Kismet/GameplayStatics.h"
+
+DECLARE_CYCLE_STAT(TEXT("Game Mode Pre Login"), STAT_FlybotGameModePreLogin, STATGROUP_Flybot);
+DECLARE_CYCLE_STAT(TEXT("Game Mode Init New Player"), STAT_FlybotGameModeInitNewPlayer, STATGROUP_Flybot);
 
 AFlybotGameMode::AFlybotGameMode()
 {
+	bGenerateMap = false;
+	MapRoomClass = AFlybotMapRoom::StaticClass();
+
+	// Leave some headroom under the 33ms frame of a 30Hz server.
+	MaxServerFrameTime = 0.025f;
+	MaxOutBytesPerConnection = 0.f;
 }
 
 void AFlybotGameMode::InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage)
@@ -14,8 +27,35 @@ void AFlybotGameMode::InitGame(const FString& MapName, const FString& Options, F
     Super::InitGame(MapName, Options, ErrorMessage);
     UE_LOG(LogFlybot, Log, TEXT("Game is running: %s %s"), *MapName, *Options);
 
+	// Load tests need to turn admission control off to reach their player counts.
+	if (UGameplayStatics::HasOption(Options, TEXT("MaxServerFrameTime")))
+	{
+		MaxServerFrameTime = FCString::Atof(*UGameplayStatics::ParseOption(Options, TEXT("MaxServerFrameTime")));
+	}
+
+	if (UGameplayStatics::HasOption(Options, TEXT("MaxOutBytesPerConnection")))
+	{
+		MaxOutBytesPerConnection = FCString::Atof(*UGameplayStatics::ParseOption(Options, TEXT("MaxOutBytesPerConnection")));
+	}
+
+	// Generate before looking for player starts, since the generated map adds its own. Players should
+	// start in the generated map, so skip the player starts placed in the level.
+	TSet<APlayerStart*> PlacedPlayerStarts;
+	if (bGenerateMap || UGameplayStatics::HasOption(Options, TEXT("GenerateMap")))
+	{
+		for (TActorIterator<APlayerStart> It(GetWorld()); It; ++It)
+		{
+			PlacedPlayerStarts.Add(*It);
+		}
+
+		GenerateMap(Options);
+	}
+
 	for (TActorIterator<APlayerStart> It(GetWorld()); It; ++It)
 	{
+		if (PlacedPlayerStarts.Contains(*It))
+			continue;
+
 		FreePlayerStarts.Add(*It);
 		UE_LOG(LogFlybot, Log, TEXT("Found player start: %s"), *(*It)->GetName());
 	}
@@ -23,16 +63,24 @@ void AFlybotGameMode::InitGame(const FString& MapName, const FString& Options, F
 
 void AFlybotGameMode::PreLogin(const FString& Options, const FString& Address, const FUniqueNetIdRepl& UniqueId, FString& ErrorMessage)
 {
+	FLYBOT_SCOPE_CYCLE_COUNTER(STAT_FlybotGameModePreLogin);
+
 	if (FreePlayerStarts.Num() == 0)
 	{
 		ErrorMessage = TEXT("Server full");
 	}
+	else if (IsServerBusy())
+	{
+		ErrorMessage = TEXT("Server busy");
+	}
 
 	Super::PreLogin(Options, Address, UniqueId, ErrorMessage);
 }
 
 FString AFlybotGameMode::InitNewPlayer(APlayerController* NewPlayerController, const FUniqueNetIdRepl& UniqueId, const FString& Options, const FString& Portal)
 {
+	FLYBOT_SCOPE_CYCLE_COUNTER(STAT_FlybotGameModeInitNewPlayer);
+
 	if (FreePlayerStarts.Num() == 0)
 	{
 		UE_LOG(LogFlybot, Log, TEXT("No free player starts in InitNewPlayer"));
@@ -43,4 +91,58 @@ FString AFlybotGameMode::InitNewPlayer(APlayerController* NewPlayerController, c
 	UE_LOG(LogFlybot, Log, TEXT("Using player start %s for %s"),
 		*NewPlayerController->StartSpot->GetName(), *NewPlayerController->GetName());
 	return Super::InitNewPlayer(NewPlayerController, UniqueId, Options, Portal);
-}
\ No newline at end of file
+}
+
+void AFlybotGameMode::Logout(AController* Exiting)
+{
+	// Give the player start back so the next player can use it.
+	APlayerStart* PlayerStart = Cast<APlayerStart>(Exiting->StartSpot.Get());
+	if (PlayerStart)
+	{
+		FreePlayerStarts.AddUnique(PlayerStart);
+		UE_LOG(LogFlybot, Log, TEXT("Freed player start %s from %s"), *PlayerStart->GetName(), *Exiting->GetName());
+	}
+
+	Super::Logout(Exiting);
+}
+
+bool AFlybotGameMode::IsServerBusy() const
+{
+	const UFlybotServerStats* ServerStats = GetWorld()->GetSubsystem<UFlybotServerStats>();
+	if (!ServerStats)
+		return false;
+
+	double FrameSeconds = ServerStats->GetSmoothedFrameSeconds();
+	if (MaxServerFrameTime > 0.f && FrameSeconds > MaxServerFrameTime)
+	{
+		UE_LOG(LogFlybot, Log, TEXT("Server busy, frame time %.1fms is over %.1fms"),
+			FrameSeconds * 1000.0, MaxServerFrameTime * 1000.f);
+		return true;
+	}
+
+	double OutBytes = ServerStats->GetOutBytesPerConnection();
+	if (MaxOutBytesPerConnection > 0.f && OutBytes > MaxOutBytesPerConnection)
+	{
+		UE_LOG(LogFlybot, Log, TEXT("Server busy, %.0f bytes per second per connection is over %.0f"),
+			OutBytes, MaxOutBytesPerConnection);
+		return true;
+	}
+
+	return false;
+}
+
+void AFlybotGameMode::GenerateMap(const FString& Options)
+{
+	FFlybotMapSettings Settings = MapSettings;
+	Settings.Seed = UGameplayStatics::GetIntOption(Options, TEXT("MapSeed"), FMath::Rand());
+	Settings.RoomCount = UGameplayStatics::GetIntOption(Options, TEXT("MapRooms"), Settings.RoomCount);
+	Settings.PlayerStartCount = UGameplayStatics::GetIntOption(Options, TEXT("MapPlayerStarts"), Settings.PlayerStartCount);
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	AFlybotMapGenerator* MapGenerator = GetWorld()->SpawnActor<AFlybotMapGenerator>(SpawnParams);
+	if (MapGenerator)
+	{
+		MapGenerator->GenerateMap(Settings, MapRoomClass);
+	}
+}
@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/GameModeBase.h"
+#include "FlybotMapLayout.h"
 #include "FlybotGameMode.generated.h"
 
 UCLASS()
@@ -16,7 +17,49 @@ public:
 	virtual void InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage) override;
 	virtual void PreLogin(const FString& Options, const FString& Address, const FUniqueNetIdRepl& UniqueId, FString& ErrorMessage) override;
 	virtual FString InitNewPlayer(APlayerController* NewPlayerController, const FUniqueNetIdRepl& UniqueId, const FString& Options, const FString& Portal = TEXT("")) override;
+	virtual void Logout(AController* Exiting) override;
+
+	/**
+	 * Generate a map at startup, also set with ?GenerateMap. Rooms placed in the level stay, but players
+	 * only start in the generated map.
+	 */
+	UPROPERTY(EditAnywhere, Category = "Map Generation")
+	bool bGenerateMap;
+
+	/**
+	 * Settings for the generated map. The seed is random unless set with ?MapSeed=, ?MapRooms= sets the
+	 * room count and ?MapPlayerStarts= the player start count.
+	 */
+	UPROPERTY(EditAnywhere, Category = "Map Generation")
+	FFlybotMapSettings MapSettings;
+
+	/** Room class to use for the generated map. */
+	UPROPERTY(EditAnywhere, Category = "Map Generation")
+	TSubclassOf<class AFlybotMapRoom> MapRoomClass;
+
+	/** Player starts left for new players. */
+	int32 GetNumFreePlayerStarts() const { return FreePlayerStarts.Num(); }
+
+	/**
+	 * Reject new players while the smoothed server frame time is over this many seconds, 0 to disable.
+	 * Also set with ?MaxServerFrameTime=.
+	 */
+	UPROPERTY(EditAnywhere, Category = "Admission")
+	float MaxServerFrameTime;
+
+	/**
+	 * Reject new players while the average bytes per second sent to each connection is over this, 0 to
+	 * disable. Also set with ?MaxOutBytesPerConnection=.
+	 */
+	UPROPERTY(EditAnywhere, Category = "Admission")
+	float MaxOutBytesPerConnection;
 
 private:
+	/** Whether the server is already over its frame time or bandwidth budget, so another player would degrade the match. */
+	bool IsServerBusy() const;
+
+	/** Spawn the map generator with settings from the game mode and options. */
+	void GenerateMap(const FString& Options);
+
 	TArray<class APlayerStart*> FreePlayerStarts;
 };
\ No newline at end of file
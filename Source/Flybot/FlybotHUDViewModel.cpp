@@ -0,0 +1,27 @@
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+#include "FlybotHUDViewModel.h"
+
+UFlybotHUDViewModel::UFlybotHUDViewModel()
+{
+	DisplayEpsilon = 0.005f;
+
+	for (float& Fraction : Fractions)
+	{
+		Fraction = 1.f;
+	}
+}
+
+void UFlybotHUDViewModel::SetStat(EFlybotHUDStat Stat, float Value, float MaxValue)
+{
+	float Fraction = MaxValue > 0.f ? FMath::Clamp(Value / MaxValue, 0.f, 1.f) : 0.f;
+	float& Displayed = Fractions[uint8(Stat)];
+
+	// Always show exactly empty and full, even if the last change was smaller than the epsilon.
+	bool bEndpoint = (Fraction == 0.f || Fraction == 1.f) && Fraction != Displayed;
+	if (!bEndpoint && FMath::Abs(Fraction - Displayed) <= DisplayEpsilon)
+		return;
+
+	Displayed = Fraction;
+	OnStatChanged.Broadcast(Stat, Fraction);
+}
@@ -0,0 +1,49 @@
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Object.h"
+#include "FlybotHUDViewModel.generated.h"
+
+/** Stats shown on the HUD. Add new stats before Num and give them a widget in UFlybotPlayerHUD. */
+UENUM()
+enum class EFlybotHUDStat : uint8
+{
+	Health,
+	Power,
+	Num UMETA(Hidden)
+};
+
+DECLARE_MULTICAST_DELEGATE_TwoParams(FFlybotHUDStatChanged, EFlybotHUDStat /* Stat */, float /* Fraction */);
+
+/**
+ * Holds the stats shown on the HUD. Gameplay code sets stats as often as it likes, and widgets are
+ * only told about a change when the displayed fraction moves by more than DisplayEpsilon, so an
+ * unchanged HUD is never invalidated and costs nothing to paint.
+ */
+UCLASS()
+class FLYBOT_API UFlybotHUDViewModel : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	UFlybotHUDViewModel();
+
+	/** Set the current and max value of a stat, notifying widgets if the displayed fraction changes. */
+	void SetStat(EFlybotHUDStat Stat, float Value, float MaxValue);
+
+	/** Fraction of the stat currently displayed, from 0 to 1. */
+	float GetStatFraction(EFlybotHUDStat Stat) const { return Fractions[uint8(Stat)]; }
+
+	/** Called with the new fraction whenever a displayed stat changes. */
+	FFlybotHUDStatChanged OnStatChanged;
+
+	/** Smallest change in a displayed fraction worth updating widgets for, about a pixel on the bars. */
+	UPROPERTY(EditAnywhere)
+	float DisplayEpsilon;
+
+private:
+	/** Displayed fraction of each stat. */
+	float Fractions[uint8(EFlybotHUDStat::Num)];
+};
@@ -0,0 +1,253 @@
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+#include "Flybot.h"
+#include "FlybotMapGeometry.h"
+#include "FlybotMapRoom.h"
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
+#include "ConvexVolume.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+
+/** Culling results for one view of one component. */
+struct FCullingResult
+{
+	int32 VisibleInstances = 0;
+	double Seconds = 0.0;
+};
+
+/** Whether a box is within the component's end cull distance and inside the view frustum. */
+static bool IsBoxVisible(const FBox& Box, const FVector& ViewLocation, const FConvexVolume& Frustum,
+	const UInstancedStaticMeshComponent* Component)
+{
+	if (Component->InstanceEndCullDistance > 0 &&
+		Box.ComputeSquaredDistanceToPoint(ViewLocation) > FMath::Square(float(Component->InstanceEndCullDistance)))
+		return false;
+
+	return Frustum.IntersectBox(Box.GetCenter(), Box.GetExtent());
+}
+
+/** Cull every instance on its own, which is what a plain instanced component has to do. */
+static FCullingResult CullInstances(const UInstancedStaticMeshComponent* Component,
+	const FVector& ViewLocation, const FConvexVolume& Frustum)
+{
+	FCullingResult Result;
+	double StartTime = FPlatformTime::Seconds();
+
+	FBox MeshBounds = Component->GetStaticMesh()->GetBoundingBox();
+	const FTransform& ComponentTransform = Component->GetComponentTransform();
+	for (const FInstancedStaticMeshInstanceData& Instance : Component->PerInstanceSMData)
+	{
+		FBox Box = MeshBounds.TransformBy(FTransform(Instance.Transform) * ComponentTransform);
+		if (IsBoxVisible(Box, ViewLocation, Frustum, Component))
+			Result.VisibleInstances++;
+	}
+
+	Result.Seconds = FPlatformTime::Seconds() - StartTime;
+	return Result;
+}
+
+/** Cull clusters of instances through the hierarchical component's cluster tree. */
+static FCullingResult CullClusters(const UHierarchicalInstancedStaticMeshComponent* Component,
+	const FVector& ViewLocation, const FConvexVolume& Frustum)
+{
+	FCullingResult Result;
+	double StartTime = FPlatformTime::Seconds();
+
+	const TArray<FClusterNode>* ClusterTree = Component->ClusterTreePtr.Get();
+	if (ClusterTree && ClusterTree->Num() > 0)
+	{
+		const FTransform& ComponentTransform = Component->GetComponentTransform();
+		TArray<int32, TInlineAllocator<64>> Nodes;
+		Nodes.Add(0);
+
+		while (Nodes.Num() > 0)
+		{
+			const FClusterNode& Node = (*ClusterTree)[Nodes.Pop(false)];
+			FBox Box = FBox(FVector(Node.BoundMin), FVector(Node.BoundMax)).TransformBy(ComponentTransform);
+			if (!IsBoxVisible(Box, ViewLocation, Frustum, Component))
+				continue;
+
+			// Leaves have no children, and every instance in a visible leaf gets drawn.
+			if (Node.FirstChild < 0)
+			{
+				Result.VisibleInstances += Node.LastInstance - Node.FirstInstance + 1;
+				continue;
+			}
+
+			for (int32 Child = Node.FirstChild; Child <= Node.LastChild; Child++)
+			{
+				Nodes.Add(Child);
+			}
+		}
+	}
+
+	Result.Seconds = FPlatformTime::Seconds() - StartTime;
+	return Result;
+}
+
+/** View frustum looking down a tube from a point inside it. */
+static FConvexVolume MakeViewFrustum(const FVector& ViewLocation, const FRotator& ViewRotation)
+{
+	// Convert from the engine's X forward to the projection's Z forward.
+	FMatrix ViewMatrix = FTranslationMatrix(-ViewLocation) * FInverseRotationMatrix(ViewRotation) *
+		FMatrix(FPlane(0, 0, 1, 0), FPlane(1, 0, 0, 0), FPlane(0, 1, 0, 0), FPlane(0, 0, 0, 1));
+	FMatrix ProjectionMatrix = FReversedZPerspectiveMatrix(FMath::DegreesToRadians(45.f), 16.f, 9.f, 10.f);
+
+	FConvexVolume Frustum;
+	GetViewFrustumBounds(Frustum, ViewMatrix * ProjectionMatrix, false);
+	return Frustum;
+}
+
+/**
+ * Measure culling from several views along every tube, comparing per-instance culling with the
+ * cluster tree of the hierarchical components. The numbers only include the CPU side of culling.
+ */
+static void BenchmarkTubeCulling(const TArray<FString>& Args, UWorld* World)
+{
+	int32 ViewsPerTube = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 5;
+
+	TArray<UHierarchicalInstancedStaticMeshComponent*> Components;
+	TArray<FVector> TubeStarts;
+	TArray<FVector> TubeEnds;
+	TArray<UHierarchicalInstancedStaticMeshComponent*> RoomComponents;
+	for (TActorIterator<AFlybotMapRoom> It(World); It; ++It)
+	{
+		// GetComponents resets the array, so gather each room separately.
+		It->GetComponents<UHierarchicalInstancedStaticMeshComponent>(RoomComponents, false);
+		Components.Append(RoomComponents);
+		It->GetTubes(TubeStarts, TubeEnds);
+	}
+
+	Components.RemoveAllSwap([](UHierarchicalInstancedStaticMeshComponent* Component)
+	{
+		return !Component->GetStaticMesh() || Component->GetInstanceCount() == 0;
+	});
+
+	int32 TotalInstances = 0;
+	for (UHierarchicalInstancedStaticMeshComponent* Component : Components)
+	{
+		Component->BuildTreeIfOutdated(false, false);
+		TotalInstances += Component->GetInstanceCount();
+	}
+
+	UE_LOG(LogFlybot, Log, TEXT("BenchmarkTubeCulling %d tubes, %d components, %d instances"),
+		TubeStarts.Num(), Components.Num(), TotalInstances);
+
+	FCullingResult InstanceTotal;
+	FCullingResult ClusterTotal;
+	for (int32 Tube = 0; Tube < TubeStarts.Num(); Tube++)
+	{
+		FRotator ViewRotation = (TubeEnds[Tube] - TubeStarts[Tube]).Rotation();
+		for (int32 View = 0; View < ViewsPerTube; View++)
+		{
+			FVector ViewLocation = FMath::Lerp(TubeStarts[Tube], TubeEnds[Tube], (View + 0.5f) / ViewsPerTube);
+			FConvexVolume Frustum = MakeViewFrustum(ViewLocation, ViewRotation);
+
+			FCullingResult InstanceResult;
+			FCullingResult ClusterResult;
+			for (UHierarchicalInstancedStaticMeshComponent* Component : Components)
+			{
+				FCullingResult Result = CullInstances(Component, ViewLocation, Frustum);
+				InstanceResult.VisibleInstances += Result.VisibleInstances;
+				InstanceResult.Seconds += Result.Seconds;
+
+				Result = CullClusters(Component, ViewLocation, Frustum);
+				ClusterResult.VisibleInstances += Result.VisibleInstances;
+				ClusterResult.Seconds += Result.Seconds;
+			}
+
+			UE_LOG(LogFlybot, Log,
+				TEXT("BenchmarkTubeCulling Tube %d View %d: Instances %d visible %.3fms, Clusters %d visible %.3fms"),
+				Tube, View, InstanceResult.VisibleInstances, InstanceResult.Seconds * 1000.0,
+				ClusterResult.VisibleInstances, ClusterResult.Seconds * 1000.0);
+
+			InstanceTotal.VisibleInstances += InstanceResult.VisibleInstances;
+			InstanceTotal.Seconds += InstanceResult.Seconds;
+			ClusterTotal.VisibleInstances += ClusterResult.VisibleInstances;
+			ClusterTotal.Seconds += ClusterResult.Seconds;
+		}
+	}
+
+	int32 NumViews = FMath::Max(TubeStarts.Num() * ViewsPerTube, 1);
+	UE_LOG(LogFlybot, Log,
+		TEXT("BenchmarkTubeCulling Average: Instances %d visible %.3fms, Clusters %d visible %.3fms"),
+		InstanceTotal.VisibleInstances / NumViews, InstanceTotal.Seconds * 1000.0 / NumViews,
+		ClusterTotal.VisibleInstances / NumViews, ClusterTotal.Seconds * 1000.0 / NumViews);
+}
+
+static FAutoConsoleCommandWithWorldAndArgs BenchmarkTubeCullingCommand(
+	TEXT("Flybot.BenchmarkTubeCulling"),
+	TEXT("Measure visible instances and culling time from views along each tube. Args: [ViewsPerTube]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&BenchmarkTubeCulling));
+
+/**
+ * Compare analytic sweeps with physics sweeps for random short moves inside the rooms, the same
+ * kind of query the server runs for every client move.
+ */
+static void BenchmarkMapQueries(const TArray<FString>& Args, UWorld* World)
+{
+	int32 NumQueries = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 10000;
+	float Radius = Args.Num() > 1 ? FCString::Atof(*Args[1]) : 50.f;
+	float MoveLength = Args.Num() > 2 ? FCString::Atof(*Args[2]) : 500.f;
+
+	UFlybotMapGeometry* MapGeometry = World->GetSubsystem<UFlybotMapGeometry>();
+	TArray<FBox> RoomBounds;
+	for (TActorIterator<AFlybotMapRoom> It(World); It; ++It)
+	{
+		RoomBounds.Add(It->GetRoomBounds(false));
+	}
+
+	if (!MapGeometry || !MapGeometry->HasRooms() || RoomBounds.Num() == 0)
+	{
+		UE_LOG(LogFlybot, Log, TEXT("BenchmarkMapQueries No rooms to query"));
+		return;
+	}
+
+	// Same moves for both paths.
+	FRandomStream Random(NumQueries);
+	TArray<FVector> Starts;
+	TArray<FVector> Ends;
+	for (int32 Index = 0; Index < NumQueries; Index++)
+	{
+		const FBox& Bounds = RoomBounds[Random.RandHelper(RoomBounds.Num())];
+		FVector Start = Random.RandPointInBox(Bounds.ExpandBy(-Radius * 2.f));
+		Starts.Add(Start);
+		Ends.Add(Start + Random.GetUnitVector() * MoveLength);
+	}
+
+	FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(FlybotBenchmarkMapQueries));
+	FCollisionShape Sphere = FCollisionShape::MakeSphere(Radius);
+	TBitArray<> PhysicsHits(false, NumQueries);
+	double StartTime = FPlatformTime::Seconds();
+	for (int32 Index = 0; Index < NumQueries; Index++)
+	{
+		FHitResult Hit;
+		PhysicsHits[Index] = World->SweepSingleByChannel(Hit, Starts[Index], Ends[Index], FQuat::Identity,
+			ECC_WorldStatic, Sphere, QueryParams);
+	}
+	double PhysicsTime = FPlatformTime::Seconds() - StartTime;
+
+	int32 NumPhysicsHits = 0;
+	int32 NumAnalyticHits = 0;
+	int32 NumMatches = 0;
+	StartTime = FPlatformTime::Seconds();
+	for (int32 Index = 0; Index < NumQueries; Index++)
+	{
+		FFlybotMapHit Hit;
+		bool bHit = MapGeometry->SweepSphere(Starts[Index], Ends[Index], Radius, Hit);
+		NumAnalyticHits += bHit;
+		NumPhysicsHits += PhysicsHits[Index];
+		NumMatches += bHit == PhysicsHits[Index];
+	}
+	double AnalyticTime = FPlatformTime::Seconds() - StartTime;
+
+	UE_LOG(LogFlybot, Log,
+		TEXT("BenchmarkMapQueries %d sweeps: Physics %.3fus each, %d hits, Analytic %.3fus each, %d hits, %.1f%% agree"),
+		NumQueries, PhysicsTime * 1000000.0 / NumQueries, NumPhysicsHits,
+		AnalyticTime * 1000000.0 / NumQueries, NumAnalyticHits, NumMatches * 100.f / NumQueries);
+}
+
+static FAutoConsoleCommandWithWorldAndArgs BenchmarkMapQueriesCommand(
+	TEXT("Flybot.BenchmarkMapQueries"),
+	TEXT("Time analytic map sweeps against physics sweeps. Args: [Count] [Radius] [MoveLength]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&BenchmarkMapQueries));
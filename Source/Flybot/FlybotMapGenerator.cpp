@@ -0,0 +1,140 @@
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+#include "FlybotMapGenerator.h"
+#include "Flybot.h"
+#include "FlybotMapRoom.h"
+#include "FlybotReplicationGraph.h"
+#include "Engine/NetDriver.h"
+#include "GameFramework/PlayerStart.h"
+#include "Net/Core/PushModel/PushModel.h"
+#include "Net/UnrealNetwork.h"
+
+DECLARE_CYCLE_STAT(TEXT("Map Generator Build"), STAT_FlybotMapGeneratorBuild, STATGROUP_Flybot);
+
+AFlybotMapGenerator::AFlybotMapGenerator()
+{
+	PrimaryActorTick.bCanEverTick = false;
+	bReplicates = true;
+	bAlwaysRelevant = true;
+	SetReplicatingMovement(false);
+	NetUpdateFrequency = 1.f;
+	MapRoomClass = AFlybotMapRoom::StaticClass();
+}
+
+void AFlybotMapGenerator::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	// The map never changes once generated.
+	FDoRepLifetimeParams InitialOnlyParams;
+	InitialOnlyParams.bIsPushBased = true;
+	InitialOnlyParams.Condition = COND_InitialOnly;
+	DOREPLIFETIME_WITH_PARAMS_FAST(AFlybotMapGenerator, MapRoomClass, InitialOnlyParams);
+	DOREPLIFETIME_WITH_PARAMS_FAST(AFlybotMapGenerator, Settings, InitialOnlyParams);
+}
+
+void AFlybotMapGenerator::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	for (AActor* Actor : SpawnedActors)
+	{
+		if (IsValid(Actor))
+			Actor->Destroy();
+	}
+
+	SpawnedActors.Reset();
+	Super::EndPlay(EndPlayReason);
+}
+
+void AFlybotMapGenerator::GenerateMap(const FFlybotMapSettings& NewSettings,
+	TSubclassOf<AFlybotMapRoom> NewMapRoomClass)
+{
+	Settings = NewSettings;
+	MARK_PROPERTY_DIRTY_FROM_NAME(AFlybotMapGenerator, Settings, this);
+
+	if (NewMapRoomClass)
+	{
+		MapRoomClass = NewMapRoomClass;
+		MARK_PROPERTY_DIRTY_FROM_NAME(AFlybotMapGenerator, MapRoomClass, this);
+	}
+
+	BuildMap(true);
+}
+
+void AFlybotMapGenerator::PostNetInit()
+{
+	Super::PostNetInit();
+	BuildMap(false);
+}
+
+void AFlybotMapGenerator::BuildMap(bool bSpawnPlayerStarts)
+{
+	FLYBOT_SCOPE_CYCLE_COUNTER(STAT_FlybotMapGeneratorBuild);
+
+	if (!MapRoomClass)
+	{
+		UE_LOG(LogFlybot, Warning, TEXT("AFlybotMapGenerator::BuildMap No map room class"));
+		return;
+	}
+
+	for (AActor* Actor : SpawnedActors)
+	{
+		if (IsValid(Actor))
+			Actor->Destroy();
+	}
+
+	SpawnedActors.Reset();
+
+	double StartTime = FPlatformTime::Seconds();
+	FFlybotMapLayout Layout;
+	Layout.Generate(Settings);
+	double LayoutTime = FPlatformTime::Seconds();
+
+	// Room properties have to be set before construction, so spawn deferred.
+	float GridSize = MapRoomClass->GetDefaultObject<AFlybotMapRoom>()->GridSize;
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.Owner = this;
+	SpawnParams.bDeferConstruction = true;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	for (const FFlybotMapLayoutRoom& LayoutRoom : Layout.Rooms)
+	{
+		FTransform Transform(FVector(LayoutRoom.Location) * GridSize);
+		AFlybotMapRoom* Room = GetWorld()->SpawnActor<AFlybotMapRoom>(MapRoomClass, Transform, SpawnParams);
+		if (!Room)
+			continue;
+
+		Room->RoomSize = LayoutRoom.RoomSize;
+		Room->PositiveXTubeSize = LayoutRoom.TubeSizes[0];
+		Room->NegativeXTubeSize = LayoutRoom.TubeSizes[1];
+		Room->PositiveYTubeSize = LayoutRoom.TubeSizes[2];
+		Room->NegativeYTubeSize = LayoutRoom.TubeSizes[3];
+		Room->PositiveZTubeSize = LayoutRoom.TubeSizes[4];
+		Room->NegativeZTubeSize = LayoutRoom.TubeSizes[5];
+		Room->FinishSpawning(Transform);
+		SpawnedActors.Add(Room);
+	}
+
+	if (bSpawnPlayerStarts)
+	{
+		SpawnParams.bDeferConstruction = false;
+		for (int32 RoomIndex : Layout.PlayerStartRooms)
+		{
+			FVector Location = FVector(Layout.Rooms[RoomIndex].Location) * GridSize;
+			SpawnedActors.Add(GetWorld()->SpawnActor<APlayerStart>(Location, FRotator::ZeroRotator, SpawnParams));
+		}
+	}
+
+	// The replication grid was laid out before these rooms existed.
+	UNetDriver* NetDriver = GetNetDriver();
+	UFlybotReplicationGraph* ReplicationGraph =
+		NetDriver ? Cast<UFlybotReplicationGraph>(NetDriver->GetReplicationDriver()) : nullptr;
+	if (ReplicationGraph && HasAuthority())
+	{
+		ReplicationGraph->UpdateGridLayout();
+	}
+
+	UE_LOG(LogFlybot, Log,
+		TEXT("AFlybotMapGenerator::BuildMap Seed %d, %d rooms, %d player starts, layout %.2fms, spawn %.2fms"),
+		Settings.Seed, Layout.Rooms.Num(), bSpawnPlayerStarts ? Layout.PlayerStartRooms.Num() : 0,
+		(LayoutTime - StartTime) * 1000.0, (FPlatformTime::Seconds() - LayoutTime) * 1000.0);
+}
@@ -0,0 +1,53 @@
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "FlybotMapLayout.h"
+#include "FlybotMapGenerator.generated.h"
+
+/**
+ * Builds a generated map from a seed. The server spawns this with the map settings, and only the
+ * settings are replicated, so clients generate the same layout and spawn their own rooms instead
+ * of replicating every room actor.
+ */
+UCLASS()
+class FLYBOT_API AFlybotMapGenerator : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	AFlybotMapGenerator();
+
+	/** Setup properties that should be replicated from the server to clients. */
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+	/** Remove the rooms and player starts this generated. */
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	/**
+	 * Generate the map on clients once the initial properties have arrived. Settings equal to the
+	 * defaults are never sent, so this can't wait for a rep notify.
+	 */
+	virtual void PostNetInit() override;
+
+	/** Generate the map on the server, including player starts. */
+	void GenerateMap(const FFlybotMapSettings& NewSettings, TSubclassOf<class AFlybotMapRoom> NewMapRoomClass);
+
+	/** Room class to spawn, with the meshes to use. */
+	UPROPERTY(EditAnywhere, Replicated)
+	TSubclassOf<class AFlybotMapRoom> MapRoomClass;
+
+	/** Settings the map was generated with. */
+	UPROPERTY(EditAnywhere, Replicated)
+	FFlybotMapSettings Settings;
+
+private:
+	/** Generate the layout and spawn rooms for it, and player starts if requested. */
+	void BuildMap(bool bSpawnPlayerStarts);
+
+	/** Rooms and player starts spawned for the map. */
+	UPROPERTY()
+	TArray<AActor*> SpawnedActors;
+};
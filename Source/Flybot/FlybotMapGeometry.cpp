@@ -0,0 +1,431 @@
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+#include "FlybotMapGeometry.h"
+#include "Flybot.h"
+#include "FlybotMapRoom.h"
+
+TAutoConsoleVariable<bool> CVarFlybotAnalyticMapCollision(
+	TEXT("Flybot.AnalyticMapCollision"),
+	false,
+	TEXT("Use analytic room and tube queries instead of physics sweeps for server move checks and the camera."));
+
+DECLARE_CYCLE_STAT(TEXT("Map Geometry Sweep"), STAT_FlybotMapGeometrySweep, STATGROUP_Flybot);
+
+FFlybotMapRoomShape::FFlybotMapRoomShape(const AFlybotMapRoom& Room)
+{
+	// Match the collision boxes built in AFlybotMapRoom.
+	float WallOffset = (Room.RoomSize / 2 + 1) * Room.GridSize;
+	Transform = Room.GetActorTransform();
+	HalfSize = WallOffset - Room.WallThickness / 2.f;
+	EdgeDistance = (WallOffset + Room.EdgeCollisionOffset) * UE_SQRT_2 - Room.WallThickness / 2.f;
+	TubeRadius = Room.TubeCollisionRadius - Room.TubeCollisionThickness / 2.f;
+
+	// Tubes end half a segment past their last position. Extend them one more segment so they
+	// overlap the tube or room they join.
+	uint32 TubeSizes[6] = {
+		Room.PositiveXTubeSize, Room.NegativeXTubeSize,
+		Room.PositiveYTubeSize, Room.NegativeYTubeSize,
+		Room.PositiveZTubeSize, Room.NegativeZTubeSize };
+	for (int32 Direction = 0; Direction < 6; Direction++)
+	{
+		TubeLengths[Direction] = TubeSizes[Direction] > 0 ?
+			WallOffset + (TubeSizes[Direction] + 0.5f) * Room.GridSize : 0.f;
+	}
+
+	Bounds = Room.GetRoomBounds(true).ExpandBy(Room.GridSize);
+}
+
+float FFlybotMapRoomShape::SignedDistance(const FVector& Point, FVector& OutNormal) const
+{
+	FVector Local = Transform.InverseTransformPositionNoScale(Point);
+	FVector Abs = Local.GetAbs();
+	FVector Signs(Local.X >= 0.f ? 1.f : -1.f, Local.Y >= 0.f ? 1.f : -1.f, Local.Z >= 0.f ? 1.f : -1.f);
+
+	// The room is convex, so the distance inside it is the distance to the nearest wall or bevel.
+	float Distance = MAX_flt;
+	FVector LocalNormal = FVector::ZeroVector;
+	for (int32 Axis = 0; Axis < 3; Axis++)
+	{
+		float WallDistance = HalfSize - Abs[Axis];
+		if (WallDistance < Distance)
+		{
+			Distance = WallDistance;
+			LocalNormal = FVector::ZeroVector;
+			LocalNormal[Axis] = -Signs[Axis];
+		}
+
+		int32 OtherAxis = (Axis + 1) % 3;
+		float EdgeWallDistance = EdgeDistance - (Abs[Axis] + Abs[OtherAxis]) * UE_INV_SQRT_2;
+		if (EdgeWallDistance < Distance)
+		{
+			Distance = EdgeWallDistance;
+			LocalNormal = FVector::ZeroVector;
+			LocalNormal[Axis] = -Signs[Axis] * UE_INV_SQRT_2;
+			LocalNormal[OtherAxis] = -Signs[OtherAxis] * UE_INV_SQRT_2;
+		}
+	}
+
+	// Tubes join the room, so the free space is whichever is furthest from its walls.
+	for (int32 Direction = 0; Direction < 6; Direction++)
+	{
+		if (TubeLengths[Direction] == 0.f)
+			continue;
+
+		int32 Axis = Direction / 2;
+		float Sign = (Direction & 1) ? -1.f : 1.f;
+		float Along = Local[Axis] * Sign;
+		FVector Perpendicular = Local;
+		Perpendicular[Axis] = 0.f;
+		float PerpendicularSize = Perpendicular.Size();
+
+		float TubeDistance = TubeRadius - PerpendicularSize;
+		FVector TubeNormal = PerpendicularSize > UE_KINDA_SMALL_NUMBER ?
+			-Perpendicular / PerpendicularSize : FVector::ZeroVector;
+		if (PerpendicularSize <= UE_KINDA_SMALL_NUMBER)
+			TubeNormal[(Axis + 1) % 3] = 1.f;
+
+		if (Along < TubeDistance)
+		{
+			TubeDistance = Along;
+			TubeNormal = FVector::ZeroVector;
+			TubeNormal[Axis] = Sign;
+		}
+
+		if (TubeLengths[Direction] - Along < TubeDistance)
+		{
+			TubeDistance = TubeLengths[Direction] - Along;
+			TubeNormal = FVector::ZeroVector;
+			TubeNormal[Axis] = -Sign;
+		}
+
+		if (TubeDistance > Distance)
+		{
+			Distance = TubeDistance;
+			LocalNormal = TubeNormal;
+		}
+	}
+
+	OutNormal = Transform.TransformVectorNoScale(LocalNormal);
+	return Distance;
+}
+
+/** Clip the range In to Out of a line to where it is on the inner side of a plane, Dot(Normal, X) <= Distance. */
+static FORCEINLINE void ClipToPlane(const FVector& Start, const FVector& Delta, const FVector& Normal, float Distance,
+	double& In, double& Out)
+{
+	double StartDistance = (Normal | Start) - Distance;
+	double Speed = Normal | Delta;
+	if (FMath::Abs(Speed) < UE_SMALL_NUMBER)
+	{
+		// Parallel to the plane, so either always inside or never.
+		if (StartDistance > 0.0)
+		{
+			In = UE_BIG_NUMBER;
+			Out = -UE_BIG_NUMBER;
+		}
+
+		return;
+	}
+
+	double Time = -StartDistance / Speed;
+	if (Speed > 0.0)
+		Out = FMath::Min(Out, Time);
+	else
+		In = FMath::Max(In, Time);
+}
+
+void FFlybotMapRoomShape::AddSweepIntervals(const FVector& Start, const FVector& End, float Radius,
+	FFlybotSweepIntervals& OutIntervals) const
+{
+	FVector Local = Transform.InverseTransformPositionNoScale(Start);
+	FVector Delta = Transform.InverseTransformVectorNoScale(End - Start);
+
+	// The room is the inside of the walls and the beveled edges.
+	double In = -UE_BIG_NUMBER;
+	double Out = UE_BIG_NUMBER;
+	for (int32 Axis = 0; Axis < 3 && In <= Out; Axis++)
+	{
+		for (float Sign : { 1.f, -1.f })
+		{
+			FVector Normal = FVector::ZeroVector;
+			Normal[Axis] = Sign;
+			ClipToPlane(Local, Delta, Normal, HalfSize - Radius, In, Out);
+		}
+
+		int32 OtherAxis = (Axis + 1) % 3;
+		for (int32 Signs = 0; Signs < 4; Signs++)
+		{
+			FVector Normal = FVector::ZeroVector;
+			Normal[Axis] = (Signs & 1) ? -UE_INV_SQRT_2 : UE_INV_SQRT_2;
+			Normal[OtherAxis] = (Signs & 2) ? -UE_INV_SQRT_2 : UE_INV_SQRT_2;
+			ClipToPlane(Local, Delta, Normal, EdgeDistance - Radius, In, Out);
+		}
+	}
+
+	if (In <= Out)
+		OutIntervals.Emplace(In, Out);
+
+	// Each tube is a cylinder from the room center to its length.
+	float CylinderRadius = TubeRadius - Radius;
+	if (CylinderRadius <= 0.f)
+		return;
+
+	for (int32 Direction = 0; Direction < 6; Direction++)
+	{
+		if (TubeLengths[Direction] == 0.f)
+			continue;
+
+		int32 Axis = Direction / 2;
+		FVector Normal = FVector::ZeroVector;
+		Normal[Axis] = (Direction & 1) ? -1.f : 1.f;
+
+		In = -UE_BIG_NUMBER;
+		Out = UE_BIG_NUMBER;
+		ClipToPlane(Local, Delta, -Normal, 0.f, In, Out);
+		ClipToPlane(Local, Delta, Normal, TubeLengths[Direction] - Radius, In, Out);
+
+		// Solve |Perpendicular(Local + Delta * T)| = CylinderRadius.
+		FVector StartPerpendicular = Local;
+		FVector DeltaPerpendicular = Delta;
+		StartPerpendicular[Axis] = 0.f;
+		DeltaPerpendicular[Axis] = 0.f;
+
+		double A = DeltaPerpendicular.SizeSquared();
+		double B = 2.0 * (StartPerpendicular | DeltaPerpendicular);
+		double C = StartPerpendicular.SizeSquared() - FMath::Square(double(CylinderRadius));
+		if (A < UE_SMALL_NUMBER)
+		{
+			// Moving along the tube, so either always inside the cylinder or never.
+			if (C > 0.0)
+				continue;
+		}
+		else
+		{
+			double Discriminant = B * B - 4.0 * A * C;
+			if (Discriminant < 0.0)
+				continue;
+
+			double Root = FMath::Sqrt(Discriminant);
+			In = FMath::Max(In, (-B - Root) / (2.0 * A));
+			Out = FMath::Min(Out, (-B + Root) / (2.0 * A));
+		}
+
+		if (In <= Out)
+			OutIntervals.Emplace(In, Out);
+	}
+}
+
+FFlybotMapHit::FFlybotMapHit()
+{
+	bBlockingHit = false;
+	bStartPenetrating = false;
+	Time = 1.f;
+	Location = FVector::ZeroVector;
+	ImpactPoint = FVector::ZeroVector;
+	ImpactNormal = FVector::ZeroVector;
+}
+
+UFlybotMapGeometry::UFlybotMapGeometry()
+{
+	CellSize = 10000.f;
+	ContactTolerance = 0.5f;
+}
+
+bool UFlybotMapGeometry::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UFlybotMapGeometry::AddRoom(const AFlybotMapRoom* Room)
+{
+	int32 ShapeIndex = Shapes.Emplace(*Room);
+	ShapeRooms.Add(Room);
+	AddShapeToCells(ShapeIndex);
+}
+
+void UFlybotMapGeometry::RemoveRoom(const AFlybotMapRoom* Room)
+{
+	int32 ShapeIndex = ShapeRooms.IndexOfByKey(Room);
+	if (ShapeIndex == INDEX_NONE)
+		return;
+
+	// Rooms are rarely removed, so rebuild the grid instead of fixing up shape indices.
+	Shapes.RemoveAtSwap(ShapeIndex);
+	ShapeRooms.RemoveAtSwap(ShapeIndex);
+	Cells.Reset();
+	for (int32 Index = 0; Index < Shapes.Num(); Index++)
+	{
+		AddShapeToCells(Index);
+	}
+}
+
+float UFlybotMapGeometry::SignedDistance(const FVector& Point, FVector* OutNormal) const
+{
+	// Points outside every room are inside walls. The grid cell size is a safe distance to report
+	// since no room is that close.
+	float Distance = -CellSize;
+	FVector Normal = FVector::ZeroVector;
+
+	if (const TArray<int32>* CellShapes = Cells.Find(GetCell(Point)))
+	{
+		for (int32 ShapeIndex : *CellShapes)
+		{
+			FVector ShapeNormal;
+			float ShapeDistance = Shapes[ShapeIndex].SignedDistance(Point, ShapeNormal);
+			if (ShapeDistance > Distance)
+			{
+				Distance = ShapeDistance;
+				Normal = ShapeNormal;
+			}
+		}
+	}
+
+	if (OutNormal)
+		*OutNormal = Normal;
+
+	return Distance;
+}
+
+FVector UFlybotMapGeometry::ClosestPoint(const FVector& Point) const
+{
+	FVector Normal;
+	float Distance = SignedDistance(Point, &Normal);
+	return Point - Normal * Distance;
+}
+
+bool UFlybotMapGeometry::SweepSphere(const FVector& Start, const FVector& End, float Radius,
+	FFlybotMapHit& OutHit) const
+{
+	FLYBOT_SCOPE_CYCLE_COUNTER(STAT_FlybotMapGeometrySweep);
+
+	OutHit = FFlybotMapHit();
+	OutHit.Location = End;
+
+	FVector Delta = End - Start;
+	float Length = Delta.Size();
+	FVector Direction = Length > UE_KINDA_SMALL_NUMBER ? Delta / Length : FVector::ZeroVector;
+
+	// Touching a wall counts as inside, so the sphere can slide along walls it rests against.
+	float InnerRadius = FMath::Max(Radius - ContactTolerance, 0.f);
+
+	// Moves are short compared to the cells, so this only visits one or two cells.
+	FIntVector MinCell = GetCell(Start.ComponentMin(End));
+	FIntVector MaxCell = GetCell(Start.ComponentMax(End));
+	TArray<int32, TInlineAllocator<16>> ShapeIndices;
+	for (int32 X = MinCell.X; X <= MaxCell.X; X++)
+	{
+		for (int32 Y = MinCell.Y; Y <= MaxCell.Y; Y++)
+		{
+			for (int32 Z = MinCell.Z; Z <= MaxCell.Z; Z++)
+			{
+				if (const TArray<int32>* CellShapes = Cells.Find(FIntVector(X, Y, Z)))
+				{
+					for (int32 ShapeIndex : *CellShapes)
+					{
+						ShapeIndices.AddUnique(ShapeIndex);
+					}
+				}
+			}
+		}
+	}
+
+	FFlybotSweepIntervals Intervals;
+	for (int32 ShapeIndex : ShapeIndices)
+	{
+		Shapes[ShapeIndex].AddSweepIntervals(Start, End, InnerRadius, Intervals);
+	}
+
+	constexpr double TimeTolerance = 1e-6;
+	bool bStartInside = Intervals.ContainsByPredicate([TimeTolerance](const FVector2D& Interval)
+	{
+		return Interval.X <= TimeTolerance && Interval.Y >= -TimeTolerance;
+	});
+
+	FVector Normal;
+	double Time = 0.0;
+	if (!bStartInside)
+	{
+		// Inside a wall already, which only blocks when moving further into it so the sphere can
+		// move back out. Outside every shape there is no way back, so that always blocks.
+		float Distance = SignedDistance(Start, &Normal) - Radius;
+		if (Normal.IsNearlyZero() || Length <= UE_KINDA_SMALL_NUMBER ||
+			(Direction | Normal) < -UE_KINDA_SMALL_NUMBER)
+		{
+			OutHit.bBlockingHit = true;
+			OutHit.bStartPenetrating = true;
+			OutHit.Time = 0.f;
+			OutHit.Location = Start;
+			OutHit.ImpactNormal = Normal.IsNearlyZero() ? -Direction : Normal;
+			OutHit.ImpactPoint = Start - Normal * (Distance + Radius);
+			return true;
+		}
+
+		// Moving out is only unblocked until the sphere reaches free space, after which it sweeps
+		// against the walls like any other move.
+		Time = 2.0;
+		for (const FVector2D& Interval : Intervals)
+		{
+			if (Interval.X <= Interval.Y && Interval.Y > 0.0)
+				Time = FMath::Min(Time, Interval.X);
+		}
+
+		if (Time >= 1.0)
+			return false;
+	}
+
+	if (Length <= UE_KINDA_SMALL_NUMBER)
+		return false;
+
+	// Free space is the union of the intervals, so walk forward through overlapping ones until we
+	// reach the end of the move or a gap. Each step moves to the end of another interval.
+	for (int32 Step = 0; Step < Intervals.Num(); Step++)
+	{
+		double Reach = Time;
+		for (const FVector2D& Interval : Intervals)
+		{
+			if (Interval.X <= Time + TimeTolerance && Interval.Y > Reach)
+				Reach = Interval.Y;
+		}
+
+		if (Reach <= Time + TimeTolerance)
+			break;
+
+		Time = Reach;
+		if (Time >= 1.0)
+			return false;
+	}
+
+	OutHit.bBlockingHit = true;
+	OutHit.Time = float(Time);
+	OutHit.Location = Start + Delta * Time;
+	SignedDistance(OutHit.Location, &Normal);
+	OutHit.ImpactNormal = Normal.IsNearlyZero() ? -Direction : Normal;
+	OutHit.ImpactPoint = OutHit.Location - OutHit.ImpactNormal * Radius;
+	return true;
+}
+
+void UFlybotMapGeometry::AddShapeToCells(int32 ShapeIndex)
+{
+	const FBox& Bounds = Shapes[ShapeIndex].Bounds;
+	FIntVector Min = GetCell(Bounds.Min);
+	FIntVector Max = GetCell(Bounds.Max);
+
+	for (int32 X = Min.X; X <= Max.X; X++)
+	{
+		for (int32 Y = Min.Y; Y <= Max.Y; Y++)
+		{
+			for (int32 Z = Min.Z; Z <= Max.Z; Z++)
+			{
+				Cells.FindOrAdd(FIntVector(X, Y, Z)).Add(ShapeIndex);
+			}
+		}
+	}
+}
+
+FIntVector UFlybotMapGeometry::GetCell(const FVector& Point) const
+{
+	return FIntVector(
+		FMath::FloorToInt(Point.X / CellSize),
+		FMath::FloorToInt(Point.Y / CellSize),
+		FMath::FloorToInt(Point.Z / CellSize));
+}
@@ -0,0 +1,148 @@
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/IConsoleManager.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "FlybotMapGeometry.generated.h"
+
+/** Whether movement and camera queries use UFlybotMapGeometry instead of physics sweeps. */
+extern TAutoConsoleVariable<bool> CVarFlybotAnalyticMapCollision;
+
+/** Ranges of a sweep, as fractions of its length, where the sphere fits inside one piece of a room. */
+using FFlybotSweepIntervals = TArray<FVector2D, TInlineAllocator<32>>;
+
+/**
+ * Free space inside one map room, described by the room parameters instead of its collision boxes.
+ * The room is a cube with beveled edges, and each tube is a cylinder running from the room center
+ * to just past the end of the tube, so joined tubes overlap and leave no seam.
+ */
+struct FLYBOT_API FFlybotMapRoomShape
+{
+	/** Room transform, queries are done in room space. */
+	FTransform Transform;
+
+	/** Distance from the room center to the inside of the walls. */
+	float HalfSize;
+
+	/** Distance from the room center to the inside of the beveled edges, along the bevel normal. */
+	float EdgeDistance;
+
+	/** Radius of the inside of the tubes. */
+	float TubeRadius;
+
+	/** Length of each tube from the room center, 0 for no tube, in AFlybotMapRoom direction order. */
+	float TubeLengths[6];
+
+	/** World space bounds of the room and tubes. */
+	FBox Bounds;
+
+	FFlybotMapRoomShape(const class AFlybotMapRoom& Room);
+
+	/**
+	 * Signed distance from a world space point to the nearest wall, positive inside the room or
+	 * tubes. OutNormal is set to the world space normal of that wall, pointing into free space.
+	 */
+	float SignedDistance(const FVector& Point, FVector& OutNormal) const;
+
+	/**
+	 * Add the ranges of the segment from Start to End where a sphere of Radius fits inside the room
+	 * or one of its tubes. The room and each tube are convex, so each gives at most one range,
+	 * found with ray tests against the walls and bevels moved in by Radius, and the tube cylinder.
+	 */
+	void AddSweepIntervals(const FVector& Start, const FVector& End, float Radius,
+		FFlybotSweepIntervals& OutIntervals) const;
+};
+
+/** Result of sweeping a sphere through the map geometry. */
+struct FLYBOT_API FFlybotMapHit
+{
+	/** Whether the sweep hit a wall. */
+	bool bBlockingHit;
+
+	/** Whether the sphere started inside a wall and was moving further into it. */
+	bool bStartPenetrating;
+
+	/** How far along the sweep the hit happened, from 0 to 1. */
+	float Time;
+
+	/** Sphere center at the hit, or the end of the sweep if nothing was hit. */
+	FVector Location;
+
+	/** Closest point on the wall that was hit. */
+	FVector ImpactPoint;
+
+	/** Normal of the wall that was hit, pointing into free space. */
+	FVector ImpactNormal;
+
+	FFlybotMapHit();
+};
+
+/**
+ * Analytic collision queries against the map rooms. Rooms register themselves on BeginPlay and are
+ * bucketed into a uniform grid. Queries only read the grid, so they are safe to run on multiple
+ * threads as long as no rooms are added or removed at the same time.
+ */
+UCLASS()
+class FLYBOT_API UFlybotMapGeometry : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	UFlybotMapGeometry();
+
+	/** Only track rooms in worlds where gameplay actually runs. */
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	/** Add a room to the queries. */
+	void AddRoom(const class AFlybotMapRoom* Room);
+
+	/** Remove a room from the queries. */
+	void RemoveRoom(const class AFlybotMapRoom* Room);
+
+	/** Whether any rooms are registered, without them every point is inside a wall. */
+	bool HasRooms() const { return Shapes.Num() > 0; }
+
+	/** Whether queries should be used instead of physics sweeps. */
+	bool IsEnabled() const { return HasRooms() && CVarFlybotAnalyticMapCollision.GetValueOnAnyThread(); }
+
+	/**
+	 * Signed distance from a point to the nearest wall, positive in free space. Inside free space
+	 * this may be less than the true distance where rooms and tubes overlap, but never more.
+	 */
+	float SignedDistance(const FVector& Point, FVector* OutNormal = nullptr) const;
+
+	/** Closest point on the nearest wall. */
+	FVector ClosestPoint(const FVector& Point) const;
+
+	/**
+	 * Sweep a sphere from Start to End, returning whether it hit a wall. The time of impact is exact,
+	 * from ray tests against each room and tube, so sliding along a wall costs the same as any move.
+	 */
+	bool SweepSphere(const FVector& Start, const FVector& End, float Radius, FFlybotMapHit& OutHit) const;
+
+	/** Size of the grid cells rooms are bucketed into. */
+	UPROPERTY(EditAnywhere)
+	float CellSize;
+
+	/** Distance from a wall that counts as touching it. */
+	UPROPERTY(EditAnywhere)
+	float ContactTolerance;
+
+private:
+	/** Shapes of all registered rooms. */
+	TArray<FFlybotMapRoomShape> Shapes;
+
+	/** Room each shape was made from. */
+	TArray<TWeakObjectPtr<const class AFlybotMapRoom>> ShapeRooms;
+
+	/** Shapes overlapping each grid cell. */
+	TMap<FIntVector, TArray<int32>> Cells;
+
+	/** Add a shape to every cell its bounds overlap. */
+	void AddShapeToCells(int32 ShapeIndex);
+
+	/** Grid cell containing a point. */
+	FIntVector GetCell(const FVector& Point) const;
+};
@@ -0,0 +1,149 @@
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+#include "FlybotMapLayout.h"
+
+/** Lattice directions in the same order as FFlybotMapLayoutRoom::TubeSizes. */
+static const FIntVector LatticeDirections[6] =
+{
+	FIntVector(1, 0, 0),
+	FIntVector(-1, 0, 0),
+	FIntVector(0, 1, 0),
+	FIntVector(0, -1, 0),
+	FIntVector(0, 0, 1),
+	FIntVector(0, 0, -1)
+};
+
+/** Index of the direction pointing the other way. */
+static FORCEINLINE int32 OppositeDirection(int32 Direction)
+{
+	return Direction ^ 1;
+}
+
+/** Distance from the center of a room to its walls in grid units, matching AFlybotMapRoom. */
+static FORCEINLINE int32 GetWallOffset(uint32 RoomSize)
+{
+	return RoomSize / 2 + 1;
+}
+
+FFlybotMapSettings::FFlybotMapSettings()
+{
+	Seed = 0;
+	RoomCount = 64;
+	MinRoomSize = 1;
+	MaxRoomSize = 5;
+	TubeLength = 4;
+	LoopChance = 0.1f;
+	PlayerStartCount = 16;
+}
+
+void FFlybotMapLayout::Generate(const FFlybotMapSettings& Settings)
+{
+	FRandomStream Random(Settings.Seed);
+	int32 RoomCount = FMath::Max(Settings.RoomCount, 1);
+	int32 MinHalfSize = FMath::Max(Settings.MinRoomSize, 1) / 2;
+	int32 MaxHalfSize = FMath::Max(Settings.MaxRoomSize / 2, MinHalfSize);
+
+	// Lattice spacing that fits two of the largest rooms with the tube length between them. Rooms
+	// are placed at the center of their lattice cell, so smaller rooms just get longer tubes.
+	int32 Spacing = GetWallOffset(MaxHalfSize * 2 + 1) * 2 + FMath::Max(Settings.TubeLength, 2) - 1;
+
+	Rooms.Reset(RoomCount);
+	PlayerStartRooms.Reset();
+
+	TMap<FIntVector, int32> RoomCells;
+	RoomCells.Reserve(RoomCount);
+	TArray<FIntVector> Cells;
+	Cells.Reserve(RoomCount);
+
+	// Joins that could be made from rooms already placed, as room index and direction.
+	TArray<TPair<int32, int32>> Frontier;
+	Frontier.Reserve(RoomCount * 4);
+
+	auto AddRoom = [&](const FIntVector& Cell)
+	{
+		int32 Index = Rooms.AddUninitialized();
+		FFlybotMapLayoutRoom& Room = Rooms[Index];
+		Room.Location = Cell * Spacing;
+		Room.RoomSize = Random.RandRange(MinHalfSize, MaxHalfSize) * 2 + 1;
+		FMemory::Memzero(Room.TubeSizes);
+
+		RoomCells.Add(Cell, Index);
+		Cells.Add(Cell);
+		for (int32 Direction = 0; Direction < 6; Direction++)
+		{
+			Frontier.Emplace(Index, Direction);
+		}
+
+		return Index;
+	};
+
+	// Place tubes on both rooms so they meet halfway, with at least the tube wall on each side.
+	// Tube segments end half a grid unit past their position, so the tubes need one extra segment.
+	auto JoinRooms = [&](int32 A, int32 B, int32 Direction)
+	{
+		int32 TubeSegments = Spacing - GetWallOffset(Rooms[A].RoomSize) - GetWallOffset(Rooms[B].RoomSize) + 1;
+		Rooms[A].TubeSizes[Direction] = TubeSegments / 2;
+		Rooms[B].TubeSizes[OppositeDirection(Direction)] = TubeSegments - TubeSegments / 2;
+	};
+
+	// Grow a random spanning tree out from the origin, so every room can be reached.
+	AddRoom(FIntVector::ZeroValue);
+	while (Rooms.Num() < RoomCount && Frontier.Num() > 0)
+	{
+		int32 FrontierIndex = Random.RandHelper(Frontier.Num());
+		TPair<int32, int32> Join = Frontier[FrontierIndex];
+		Frontier.RemoveAtSwap(FrontierIndex, 1, false);
+
+		FIntVector Cell = Cells[Join.Key] + LatticeDirections[Join.Value];
+		if (RoomCells.Contains(Cell))
+			continue;
+
+		int32 NewRoom = AddRoom(Cell);
+		JoinRooms(Join.Key, NewRoom, Join.Value);
+	}
+
+	// Add loops between neighboring rooms, only checking positive directions so each pair is seen once.
+	if (Settings.LoopChance > 0.f)
+	{
+		for (int32 Index = 0; Index < Rooms.Num(); Index++)
+		{
+			for (int32 Direction = 0; Direction < 6; Direction += 2)
+			{
+				if (Rooms[Index].TubeSizes[Direction] > 0)
+					continue;
+
+				const int32* Neighbor = RoomCells.Find(Cells[Index] + LatticeDirections[Direction]);
+				if (Neighbor && Random.FRand() < Settings.LoopChance)
+				{
+					JoinRooms(Index, *Neighbor, Direction);
+				}
+			}
+		}
+	}
+
+	// Spread player starts out with farthest point sampling, each start going in the room farthest
+	// from all the starts placed so far.
+	int32 PlayerStartCount = FMath::Clamp(Settings.PlayerStartCount, 1, Rooms.Num());
+	TArray<int64> StartDistances;
+	StartDistances.Init(MAX_int64, Rooms.Num());
+
+	int32 NextStart = 0;
+	while (PlayerStartRooms.Num() < PlayerStartCount)
+	{
+		PlayerStartRooms.Add(NextStart);
+
+		int64 FarthestDistance = -1;
+		for (int32 Index = 0; Index < Rooms.Num(); Index++)
+		{
+			FIntVector Offset = Rooms[Index].Location - Rooms[NextStart].Location;
+			int64 Distance = int64(Offset.X) * Offset.X + int64(Offset.Y) * Offset.Y + int64(Offset.Z) * Offset.Z;
+			StartDistances[Index] = FMath::Min(StartDistances[Index], Distance);
+
+			if (StartDistances[Index] > FarthestDistance)
+			{
+				FarthestDistance = StartDistances[Index];
+				NextStart = Index;
+			}
+		}
+	}
+}
@@ -0,0 +1,77 @@
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FlybotMapLayout.generated.h"
+
+/** Settings for generating a map layout. The same settings always generate the same layout. */
+USTRUCT()
+struct FLYBOT_API FFlybotMapSettings
+{
+	GENERATED_BODY()
+
+	/** Seed for the random stream used to place rooms and tubes. */
+	UPROPERTY(EditAnywhere)
+	int32 Seed;
+
+	/** How many rooms to generate. */
+	UPROPERTY(EditAnywhere, meta = (ClampMin = 1, ClampMax = 100000))
+	int32 RoomCount;
+
+	/** Smallest room size, rounded up to an odd number like AFlybotMapRoom::RoomSize. */
+	UPROPERTY(EditAnywhere, meta = (ClampMin = 1, ClampMax = 25))
+	int32 MinRoomSize;
+
+	/** Largest room size, rounded up to an odd number like AFlybotMapRoom::RoomSize. */
+	UPROPERTY(EditAnywhere, meta = (ClampMin = 1, ClampMax = 25))
+	int32 MaxRoomSize;
+
+	/** How many tube segments join the largest rooms, smaller rooms get longer tubes. */
+	UPROPERTY(EditAnywhere, meta = (ClampMin = 2, ClampMax = 500))
+	int32 TubeLength;
+
+	/** Chance of joining neighboring rooms that are not already joined, adding loops to the map. */
+	UPROPERTY(EditAnywhere, meta = (ClampMin = 0, ClampMax = 1))
+	float LoopChance;
+
+	/** How many player starts to place, at most one per room. */
+	UPROPERTY(EditAnywhere, meta = (ClampMin = 1))
+	int32 PlayerStartCount;
+
+	FFlybotMapSettings();
+};
+
+/** A room in a generated map layout. */
+struct FLYBOT_API FFlybotMapLayoutRoom
+{
+	/** Location in grid units, the same grid AFlybotMapRoom::GridSize uses. */
+	FIntVector Location;
+
+	/** Size of the room, always odd. */
+	uint32 RoomSize;
+
+	/**
+	 * Number of tube segments leaving each wall, 0 for none. Walls are in the order positive X,
+	 * negative X, positive Y, negative Y, positive Z, negative Z.
+	 */
+	uint32 TubeSizes[6];
+};
+
+/**
+ * Rooms and tubes for a generated map, without any actors. Rooms sit on a 3D lattice and are
+ * joined to neighboring rooms along the lattice axes, starting from a random spanning tree so
+ * every room is reachable, then adding some loops. Each joint is built from a tube on both rooms
+ * that meet halfway between them.
+ */
+struct FLYBOT_API FFlybotMapLayout
+{
+	/** All rooms, the first one is at the origin. */
+	TArray<FFlybotMapLayoutRoom> Rooms;
+
+	/** Rooms to place player starts in, spread as far apart as possible. */
+	TArray<int32> PlayerStartRooms;
+
+	/** Generate a new layout, replacing the current one. */
+	void Generate(const FFlybotMapSettings& Settings);
+};
@@ -2,10 +2,22 @@
 
 #include "FlybotMapRoom.h"
 #include "Flybot.h"
+#include "FlybotMapGeometry.h"
+#include "FlybotMapRoomCollision.h"
 #include "Components/BoxComponent.h"
-#include "Components/InstancedStaticMeshComponent.h"
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
 #include "Components/PointLightComponent.h"
 #include "Components/SceneComponent.h"
+#include "Async/ParallelFor.h"
+
+DECLARE_CYCLE_STAT(TEXT("Map Room Construction"), STAT_FlybotMapRoomConstruction, STATGROUP_Flybot);
+DECLARE_CYCLE_STAT(TEXT("Map Room Full Build"), STAT_FlybotMapRoomFullBuild, STATGROUP_Flybot);
+DECLARE_CYCLE_STAT(TEXT("Map Room Incremental Build"), STAT_FlybotMapRoomIncrementalBuild, STATGROUP_Flybot);
+
+FFlybotMapRoomPart::FFlybotMapRoomPart()
+{
+	TubeSize = 0;
+}
 
 AFlybotMapRoom::AFlybotMapRoom()
 {
@@ -17,32 +29,49 @@ AFlybotMapRoom::AFlybotMapRoom()
 	TubeCollisionFaces = 8;
 	TubeCollisionRadius = 425.f;
 	TubeCollisionThickness = 200.f;
+	TubeLightMode = EFlybotTubeLightMode::Clustered;
+	TubeLightClusterSize = 4;
+	MaxLightsPerTube = 16;
+	MaxTubeLightRadius = 4000.f;
 	bRebuild = true;
+	CurrentPart = ShellPart;
+	BuiltShellHash = 0;
 
 	USceneComponent* SceneComponent = CreateDefaultSubobject<USceneComponent>(TEXT("SceneComponent"));
 	SetRootComponent(SceneComponent);
 
-	Walls = CreateDefaultSubobject<UInstancedStaticMeshComponent>(TEXT("Walls"));
+	// Hierarchical instancing lets clusters of instances be culled together, so long tubes only draw
+	// the segments near the camera. Rooms are seen from further away than tube segments, so they use
+	// larger cull distances and switch LODs later. Both can be changed per component in the details.
+	Walls = CreateDefaultSubobject<UHierarchicalInstancedStaticMeshComponent>(TEXT("Walls"));
 	Walls->SetupAttachment(SceneComponent);
+	Walls->InstanceStartCullDistance = 80000;
+	Walls->InstanceEndCullDistance = 100000;
 
-	Edges = CreateDefaultSubobject<UInstancedStaticMeshComponent>(TEXT("Edges"));
+	Edges = CreateDefaultSubobject<UHierarchicalInstancedStaticMeshComponent>(TEXT("Edges"));
 	Edges->SetupAttachment(SceneComponent);
+	Edges->InstanceStartCullDistance = 80000;
+	Edges->InstanceEndCullDistance = 100000;
 
-	Corners = CreateDefaultSubobject<UInstancedStaticMeshComponent>(TEXT("Corners"));
+	Corners = CreateDefaultSubobject<UHierarchicalInstancedStaticMeshComponent>(TEXT("Corners"));
 	Corners->SetupAttachment(SceneComponent);
+	Corners->InstanceStartCullDistance = 80000;
+	Corners->InstanceEndCullDistance = 100000;
 
-	TubeWalls = CreateDefaultSubobject<UInstancedStaticMeshComponent>(TEXT("TubeWalls"));
+	TubeWalls = CreateDefaultSubobject<UHierarchicalInstancedStaticMeshComponent>(TEXT("TubeWalls"));
 	TubeWalls->SetupAttachment(SceneComponent);
+	TubeWalls->InstanceStartCullDistance = 40000;
+	TubeWalls->InstanceEndCullDistance = 50000;
+	TubeWalls->InstanceLODDistanceScale = 0.5f;
 
-	Tubes = CreateDefaultSubobject<UInstancedStaticMeshComponent>(TEXT("Tubes"));
+	Tubes = CreateDefaultSubobject<UHierarchicalInstancedStaticMeshComponent>(TEXT("Tubes"));
 	Tubes->SetupAttachment(SceneComponent);
-}
+	Tubes->InstanceStartCullDistance = 40000;
+	Tubes->InstanceEndCullDistance = 50000;
+	Tubes->InstanceLODDistanceScale = 0.5f;
 
-/** Helper function to keep calls in OnConstruction concise. */
-static FORCEINLINE void AddInstance(UInstancedStaticMeshComponent* Component,
-	const FRotator& Rotation, const FVector& Translation)
-{
-	Component->AddInstance(FTransform(Rotation, Rotation.RotateVector(Translation)));
+	Collision = CreateDefaultSubobject<UFlybotMapRoomCollision>(TEXT("Collision"));
+	Collision->SetupAttachment(SceneComponent);
 }
 
 /**
@@ -71,6 +100,107 @@ static const FRotator NegativePitch45(-45.f, 0.f, 0.f);
 static const FRotator PositiveYaw45(0.f, 45.f, 0.f);
 static const FRotator NegativeYaw45(0.f, -45.f, 0.f);
 
+/** Rotations for each tube direction, in the same order as AFlybotMapRoom::Parts. */
+static const FRotator TubeRotations[] = { PositiveX, NegativeX, PositiveY, NegativeY, PositiveZ, NegativeZ };
+
+/**
+ * Every rotation above used for mesh instances is one of 24 axis aligned orientations: the X axis
+ * faces one of six directions, with one of four rolls around it. These are precomputed, so building
+ * instances needs no trig.
+ */
+static constexpr int32 NumOrientations = 24;
+
+/** Rotation matrix with only 0, 1 and -1 entries, using the same row layout as FRotationMatrix. */
+struct FOrientationMatrix
+{
+	int8 M[3][3];
+};
+
+/** Rotation matrices for all orientations, indexed by facing * 4 + roll quarter turns. */
+struct FOrientationTable
+{
+	FOrientationMatrix Matrices[NumOrientations];
+
+	constexpr FOrientationTable() : Matrices()
+	{
+		// Sine and cosine of quarter turns.
+		constexpr int8 Sin[4] = { 0, 1, 0, -1 };
+		constexpr int8 Cos[4] = { 1, 0, -1, 0 };
+
+		// Pitch and yaw quarter turns for each facing: positive X, negative X, positive Y,
+		// negative Y, positive Z and negative Z.
+		constexpr int32 FacingPitch[6] = { 0, 0, 0, 0, 1, 3 };
+		constexpr int32 FacingYaw[6] = { 0, 2, 1, 3, 0, 0 };
+
+		for (int32 Facing = 0; Facing < 6; Facing++)
+		{
+			for (int32 Roll = 0; Roll < 4; Roll++)
+			{
+				int8 SP = Sin[FacingPitch[Facing]], CP = Cos[FacingPitch[Facing]];
+				int8 SY = Sin[FacingYaw[Facing]], CY = Cos[FacingYaw[Facing]];
+				int8 SR = Sin[Roll], CR = Cos[Roll];
+
+				int8 (&M)[3][3] = Matrices[Facing * 4 + Roll].M;
+				M[0][0] = int8(CP * CY);
+				M[0][1] = int8(CP * SY);
+				M[0][2] = SP;
+				M[1][0] = int8(SR * SP * CY - CR * SY);
+				M[1][1] = int8(SR * SP * SY + CR * CY);
+				M[1][2] = int8(-SR * CP);
+				M[2][0] = int8(-(CR * SP * CY + SR * SY));
+				M[2][1] = int8(CY * SR - CR * SP * SY);
+				M[2][2] = int8(CR * CP);
+			}
+		}
+	}
+};
+
+static constexpr FOrientationTable OrientationTable;
+
+/** Quaternions for all orientations, matching OrientationTable. */
+static const TArray<FQuat> OrientationQuats = []()
+{
+	TArray<FQuat> Quats;
+	Quats.SetNumUninitialized(NumOrientations);
+	for (int32 Index = 0; Index < NumOrientations; Index++)
+	{
+		const int8 (&M)[3][3] = OrientationTable.Matrices[Index].M;
+		FMatrix Matrix(
+			FPlane(M[0][0], M[0][1], M[0][2], 0.f),
+			FPlane(M[1][0], M[1][1], M[1][2], 0.f),
+			FPlane(M[2][0], M[2][1], M[2][2], 0.f),
+			FPlane(0.f, 0.f, 0.f, 1.f));
+		Quats[Index] = FQuat(Matrix);
+	}
+	return Quats;
+}();
+
+/** Orientation index for one of the axis aligned rotations above. */
+static uint8 GetOrientation(const FRotator& Rotation)
+{
+	int32 Pitch = FMath::RoundToInt(Rotation.Pitch / 90.f) & 3;
+	int32 Yaw = FMath::RoundToInt(Rotation.Yaw / 90.f) & 3;
+	int32 Roll = FMath::RoundToInt(Rotation.Roll / 90.f) & 3;
+
+	// Facing up or down only happens with no yaw.
+	constexpr int32 YawFacing[4] = { 0, 2, 1, 3 };
+	int32 Facing = Pitch == 1 ? 4 : (Pitch == 3 ? 5 : YawFacing[Yaw]);
+	return Facing * 4 + Roll;
+}
+
+/** Instance transform for an orientation, rotating the translation with the integer matrix. */
+static FORCEINLINE FTransform MakeInstanceTransform(uint8 Orientation, const FVector& Translation)
+{
+	const int8 (&M)[3][3] = OrientationTable.Matrices[Orientation].M;
+	return FTransform(OrientationQuats[Orientation], FVector(
+		Translation.X * M[0][0] + Translation.Y * M[1][0] + Translation.Z * M[2][0],
+		Translation.X * M[0][1] + Translation.Y * M[1][1] + Translation.Z * M[2][1],
+		Translation.X * M[0][2] + Translation.Y * M[1][2] + Translation.Z * M[2][2]));
+}
+
+/** Fill instance transforms on multiple threads when a component gets at least this many. */
+static constexpr int32 ParallelInstanceThreshold = 2048;
+
 #if WITH_EDITOR
 void AFlybotMapRoom::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
 {
@@ -83,6 +213,8 @@ void AFlybotMapRoom::PostEditChangeProperty(FPropertyChangedEvent& PropertyChang
 
 void AFlybotMapRoom::OnConstruction(const FTransform& Transform)
 {
+	FLYBOT_SCOPE_CYCLE_COUNTER(STAT_FlybotMapRoomConstruction);
+
 	Super::OnConstruction(Transform);
 
 	// Only rebuild if needed.
@@ -91,29 +223,152 @@ void AFlybotMapRoom::OnConstruction(const FTransform& Transform)
 
 	bRebuild = false;
 
+	// Rooms saved before collision was merged still have a box component for each collision box.
+	TArray<UBoxComponent*> Boxes;
+	GetComponents<UBoxComponent>(Boxes);
+	for (UBoxComponent* Box : Boxes)
+		Box->DestroyComponent();
+
+	// Implicit floor with integer division, which makes all room sizes end up being odd.
+	WallOffset = (RoomSize / 2 + 1) * GridSize;
+
+	double StartTime = FPlatformTime::Seconds();
+	if (CanRebuildIncrementally())
+	{
+		int32 RebuiltTubes = BuildIncremental();
+		UE_LOG(LogFlybot, Log,
+			TEXT("AFlybotMapRoom::OnConstruction Rebuilt %d tubes in %.2fms (this=%x)"),
+			RebuiltTubes, (FPlatformTime::Seconds() - StartTime) * 1000.0, this);
+	}
+	else
+	{
+		BuildFull();
+		UE_LOG(LogFlybot, Log,
+			TEXT("AFlybotMapRoom::OnConstruction Built Room Size %d in %.2fms (this=%x)"),
+			RoomSize, (FPlatformTime::Seconds() - StartTime) * 1000.0, this);
+	}
+
 	UE_LOG(LogFlybot, Log,
-		TEXT("AFlybotMapRoom::OnConstruction Building Room Size %d (this=%x)"),
-		RoomSize, this);
+		TEXT("AFlybotMapRoom::OnConstruction Room has %d collision boxes and %d lights (this=%x)"),
+		Collision->GetNumBoxes(), GetNumLights(), this);
+}
+
+void AFlybotMapRoom::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (UFlybotMapGeometry* MapGeometry = GetWorld()->GetSubsystem<UFlybotMapGeometry>())
+		MapGeometry->AddRoom(this);
+}
+
+void AFlybotMapRoom::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UFlybotMapGeometry* MapGeometry = GetWorld()->GetSubsystem<UFlybotMapGeometry>())
+		MapGeometry->RemoveRoom(this);
+
+	Super::EndPlay(EndPlayReason);
+}
+
+uint32 AFlybotMapRoom::GetShellHash() const
+{
+	uint32 Hash = GetTypeHash(GridSize);
+	Hash = HashCombine(Hash, GetTypeHash(RoomSize));
+	Hash = HashCombine(Hash, GetTypeHash(WallThickness));
+	Hash = HashCombine(Hash, GetTypeHash(EdgeCollisionOffset));
+	Hash = HashCombine(Hash, GetTypeHash(TubeCollisionFaces));
+	Hash = HashCombine(Hash, GetTypeHash(TubeCollisionRadius));
+	Hash = HashCombine(Hash, GetTypeHash(TubeCollisionThickness));
+	Hash = HashCombine(Hash, GetTypeHash(TubeLightMode));
+	Hash = HashCombine(Hash, GetTypeHash(TubeLightClusterSize));
+	Hash = HashCombine(Hash, GetTypeHash(MaxLightsPerTube));
+	Hash = HashCombine(Hash, GetTypeHash(MaxTubeLightRadius));
+	return Hash;
+}
+
+bool AFlybotMapRoom::CanRebuildIncrementally() const
+{
+	// Rooms saved before parts were tracked, or whose instances were changed outside of building,
+	// can't be matched up with their parts.
+	return BuiltShellHash == GetShellHash() &&
+		Walls->GetInstanceCount() == WallParts.Num() &&
+		TubeWalls->GetInstanceCount() == TubeWallParts.Num() &&
+		Tubes->GetInstanceCount() == TubeParts.Num();
+}
+
+void AFlybotMapRoom::BuildFull()
+{
+	FLYBOT_SCOPE_CYCLE_COUNTER(STAT_FlybotMapRoomFullBuild);
 
 	Walls->ClearInstances();
 	Edges->ClearInstances();
 	Corners->ClearInstances();
 	TubeWalls->ClearInstances();
 	Tubes->ClearInstances();
+	Collision->ClearBoxes();
+	WallParts.Reset();
+	TubeWallParts.Reset();
+	TubeParts.Reset();
 
+	// Remove every light, including any from rooms saved before parts were tracked.
 	TArray<UPointLightComponent*> Lights;
 	GetComponents<UPointLightComponent>(Lights);
 	for (UPointLightComponent* Light : Lights)
 		Light->DestroyComponent();
 
-	TArray<UBoxComponent*> Boxes;
-	GetComponents<UBoxComponent>(Boxes);
-	for (UBoxComponent* Box : Boxes)
-		Box->DestroyComponent();
+	for (FFlybotMapRoomPart& Part : Parts)
+	{
+		Part.TubeSize = 0;
+		Part.Lights.Reset();
+	}
 
-	// Implicit floor with integer division, which makes all room sizes end up being odd.
+	CurrentPart = ShellPart;
+	AddShellInstances();
+
+	for (int32 Direction = 0; Direction < ShellPart; Direction++)
+	{
+		CurrentPart = Direction;
+		AddTubeInstances(Direction);
+	}
+
+	AddPendingInstances();
+	Collision->UpdateCollision();
+	BuiltShellHash = GetShellHash();
+}
+
+int32 AFlybotMapRoom::BuildIncremental()
+{
+	FLYBOT_SCOPE_CYCLE_COUNTER(STAT_FlybotMapRoomIncrementalBuild);
+
+	// Remove all changed parts before adding any, since removal needs the instance counts to match
+	// the part tracking arrays.
+	TArray<int32, TInlineAllocator<6>> ChangedTubes;
+	for (int32 Direction = 0; Direction < ShellPart; Direction++)
+	{
+		if (Parts[Direction].TubeSize != GetTubeSize(Direction))
+		{
+			RemovePart(Direction);
+			ChangedTubes.Add(Direction);
+		}
+	}
+
+	if (ChangedTubes.Num() > 0)
+	{
+		for (int32 Direction : ChangedTubes)
+		{
+			CurrentPart = Direction;
+			AddTubeInstances(Direction);
+		}
+
+		AddPendingInstances();
+		Collision->UpdateCollision();
+	}
+
+	return ChangedTubes.Num();
+}
+
+void AFlybotMapRoom::AddShellInstances()
+{
 	int32 HalfSize = RoomSize / 2;
-	WallOffset = (HalfSize + 1) * GridSize;
 	FVector Translation(WallOffset, 0.f, 0.f);
 
 	for (int32 a = -HalfSize; a <= HalfSize; a++)
@@ -122,20 +377,15 @@ void AFlybotMapRoom::OnConstruction(const FTransform& Transform)
 
 		for (int32 b = -HalfSize; b <= HalfSize; b++)
 		{
-			Translation.Z = GridSize * b;
+			// The center walls belong to the tube parts, since they depend on the tube size.
+			if (a == 0 && b == 0)
+				continue;
 
-			// Build walls, placing a tube wall in the center if needed.
-			auto WallType = [&](uint32 TubeSize)
+			Translation.Z = GridSize * b;
+			for (const FRotator& Rotation : TubeRotations)
 			{
-				return (a == 0 && b == 0 && TubeSize > 0) ? TubeWalls : Walls;
-			};
-
-			AddInstance(WallType(PositiveXTubeSize), PositiveX, Translation);
-			AddInstance(WallType(NegativeXTubeSize), NegativeX, Translation);
-			AddInstance(WallType(PositiveYTubeSize), PositiveY, Translation);
-			AddInstance(WallType(NegativeYTubeSize), NegativeY, Translation);
-			AddInstance(WallType(PositiveZTubeSize), PositiveZ, Translation);
-			AddInstance(WallType(NegativeZTubeSize), NegativeZ, Translation);
+				AddInstance(Walls, Rotation, Translation);
+			}
 		}
 
 		// Build edges.
@@ -165,14 +415,6 @@ void AFlybotMapRoom::OnConstruction(const FTransform& Transform)
 	AddInstance(Corners, NegativeX180, Translation);
 	AddInstance(Corners, NegativeX270, Translation);
 
-	// Build tubes and add wall and tube collisions.
-	AddTubeInstances(PositiveXTubeSize, PositiveX);
-	AddTubeInstances(NegativeXTubeSize, NegativeX);
-	AddTubeInstances(PositiveYTubeSize, PositiveY);
-	AddTubeInstances(NegativeYTubeSize, NegativeY);
-	AddTubeInstances(PositiveZTubeSize, PositiveZ);
-	AddTubeInstances(NegativeZTubeSize, NegativeZ);
-
 	// Build edge collision boxes.
 	Translation.X = WallOffset + EdgeCollisionOffset;
 	Translation.Y = 0;
@@ -195,18 +437,167 @@ void AFlybotMapRoom::OnConstruction(const FTransform& Transform)
 	AddPointLight(2.f, WallOffset * 2, PositiveX, FVector::ZeroVector);
 }
 
-void AFlybotMapRoom::AddTubeInstances(uint32 TubeSize, const FRotator& Rotation)
+void AFlybotMapRoom::RemovePart(uint8 Part)
 {
+	RemovePartInstances(Walls, WallParts, Part);
+	RemovePartInstances(TubeWalls, TubeWallParts, Part);
+	RemovePartInstances(Tubes, TubeParts, Part);
+	Collision->RemoveBoxes(Part);
+
+	for (UPointLightComponent* Light : Parts[Part].Lights)
+	{
+		if (Light)
+			Light->DestroyComponent();
+	}
+
+	Parts[Part].Lights.Reset();
+	Parts[Part].TubeSize = 0;
+}
+
+void AFlybotMapRoom::RemovePartInstances(UInstancedStaticMeshComponent* Component,
+	TArray<uint8>& InstanceParts, uint8 Part)
+{
+	// Only ever remove the last instance, moving it into the gap first, so the remaining instances
+	// keep their indices no matter how the component handles removal.
+	for (int32 Index = InstanceParts.Num() - 1; Index >= 0; Index--)
+	{
+		if (InstanceParts[Index] != Part)
+			continue;
+
+		int32 Last = InstanceParts.Num() - 1;
+		if (Index != Last)
+		{
+			FTransform LastTransform;
+			Component->GetInstanceTransform(Last, LastTransform);
+			Component->UpdateInstanceTransform(Index, LastTransform, false, false, true);
+			InstanceParts[Index] = InstanceParts[Last];
+		}
+
+		Component->RemoveInstance(Last);
+		InstanceParts.Pop(false);
+	}
+}
+
+TArray<uint8>* AFlybotMapRoom::GetInstanceParts(UInstancedStaticMeshComponent* Component)
+{
+	if (Component == Walls)
+		return &WallParts;
+	if (Component == TubeWalls)
+		return &TubeWallParts;
+	if (Component == Tubes)
+		return &TubeParts;
+	return nullptr;
+}
+
+void AFlybotMapRoom::AddInstance(UInstancedStaticMeshComponent* Component,
+	const FRotator& Rotation, const FVector& Translation)
+{
+	if (TArray<uint8>* InstanceParts = GetInstanceParts(Component))
+		InstanceParts->Add(CurrentPart);
+
+	FPendingInstances& Pending = PendingInstances.FindOrAdd(Component);
+	Pending.Translations.Add(Translation);
+	Pending.Orientations.Add(GetOrientation(Rotation));
+}
+
+void AFlybotMapRoom::AddPendingInstances()
+{
+	for (TPair<UInstancedStaticMeshComponent*, FPendingInstances>& Pair : PendingInstances)
+	{
+		UInstancedStaticMeshComponent* Component = Pair.Key;
+		const FPendingInstances& Pending = Pair.Value;
+
+		TArray<FTransform> Transforms;
+		Transforms.SetNumUninitialized(Pending.Translations.Num());
+		ParallelFor(Transforms.Num(), [&Transforms, &Pending](int32 Index)
+		{
+			Transforms[Index] = MakeInstanceTransform(Pending.Orientations[Index], Pending.Translations[Index]);
+		}, Transforms.Num() < ParallelInstanceThreshold);
+
+		Component->AddInstances(Transforms, false);
+	}
+
+	PendingInstances.Reset();
+}
+
+uint32 AFlybotMapRoom::GetTubeSize(int32 Direction) const
+{
+	const uint32* TubeSizes[] = {
+		&PositiveXTubeSize, &NegativeXTubeSize,
+		&PositiveYTubeSize, &NegativeYTubeSize,
+		&PositiveZTubeSize, &NegativeZTubeSize };
+	return *TubeSizes[Direction];
+}
+
+int32 AFlybotMapRoom::GetNumLights() const
+{
+	int32 NumLights = 0;
+	for (const FFlybotMapRoomPart& Part : Parts)
+		NumLights += Part.Lights.Num();
+	return NumLights;
+}
+
+FBox AFlybotMapRoom::GetRoomBounds(bool bIncludeTubes) const
+{
+	// Match the wall offset calculation in OnConstruction.
+	float Offset = (RoomSize / 2 + 1) * GridSize;
+	FBox Bounds(FVector(-Offset), FVector(Offset));
+
+	if (bIncludeTubes)
+	{
+		Bounds.Max.X += PositiveXTubeSize * GridSize;
+		Bounds.Min.X -= NegativeXTubeSize * GridSize;
+		Bounds.Max.Y += PositiveYTubeSize * GridSize;
+		Bounds.Min.Y -= NegativeYTubeSize * GridSize;
+		Bounds.Max.Z += PositiveZTubeSize * GridSize;
+		Bounds.Min.Z -= NegativeZTubeSize * GridSize;
+	}
+
+	return Bounds.TransformBy(GetActorTransform());
+}
+
+void AFlybotMapRoom::GetTubes(TArray<FVector>& OutStarts, TArray<FVector>& OutEnds) const
+{
+	float Offset = (RoomSize / 2 + 1) * GridSize;
+	const FTransform& Transform = GetActorTransform();
+
+	auto AddTube = [&](uint32 TubeSize, const FVector& Direction)
+	{
+		if (TubeSize == 0)
+			return;
+
+		OutStarts.Add(Transform.TransformPosition(Direction * Offset));
+		OutEnds.Add(Transform.TransformPosition(Direction * (Offset + TubeSize * GridSize)));
+	};
+
+	AddTube(PositiveXTubeSize, FVector::ForwardVector);
+	AddTube(NegativeXTubeSize, FVector::BackwardVector);
+	AddTube(PositiveYTubeSize, FVector::RightVector);
+	AddTube(NegativeYTubeSize, FVector::LeftVector);
+	AddTube(PositiveZTubeSize, FVector::UpVector);
+	AddTube(NegativeZTubeSize, FVector::DownVector);
+}
+
+void AFlybotMapRoom::AddTubeInstances(int32 Direction)
+{
+	uint32 TubeSize = GetTubeSize(Direction);
+	const FRotator& Rotation = TubeRotations[Direction];
+	Parts[Direction].TubeSize = TubeSize;
+
 	FVector Translation(WallOffset, 0, 0);
 	FVector Extent(WallThickness / 2.f, WallOffset, WallOffset);
 
 	if (TubeSize == 0)
 	{
-		// No tubes, so add one collision for the entire wall.
+		// No tubes, so add a plain center wall and one collision for the entire wall.
+		AddInstance(Walls, Rotation, Translation);
 		AddCollisionBox(Extent, Rotation, Translation);
 		return;
 	}
 
+	// The tube wall is the first section of the tube.
+	AddInstance(TubeWalls, Rotation, Translation);
+
 	// Setup wall collision with four sections, leaving a hole in the middle for the tube.
 	Translation.Y = (WallOffset / 2.f) - (GridSize / 4.f);
 	Translation.Z = (WallOffset / 2.f) + (GridSize / 4.f);
@@ -223,12 +614,23 @@ void AFlybotMapRoom::AddTubeInstances(uint32 TubeSize, const FRotator& Rotation)
 	Translation.Z = 0;
 	AddPointLight(1.f, GridSize, Rotation, Translation);
 
-	// Start at 1 because the first tube is the tube wall added in OnConstruction.
+	uint32 ClusterSize = GetTubeLightClusterSize(TubeSize);
+
+	// Start at 1 because the first tube is the tube wall added above.
 	for (uint32 a = 1; a < TubeSize; a++)
 	{
 		Translation.X = WallOffset + GridSize * a;
 		AddInstance(Tubes, Rotation, Translation);
-		AddPointLight(1.f, GridSize, Rotation, Translation);
+
+		if ((a - 1) % ClusterSize == 0)
+		{
+			// Light the center of the cluster, reaching to both ends of it unless that is over the cap.
+			uint32 ClusterSegments = FMath::Min(ClusterSize, TubeSize - a);
+			FVector LightTranslation = Translation;
+			LightTranslation.X += GridSize * (ClusterSegments - 1) / 2.f;
+			float Radius = FMath::Min(GridSize * (ClusterSegments + 1) / 2.f, MaxTubeLightRadius);
+			AddPointLight(1.f, Radius, Rotation, LightTranslation);
+		}
 	}
 
 	// Add tube collision boxes.
@@ -248,6 +650,24 @@ void AFlybotMapRoom::AddTubeInstances(uint32 TubeSize, const FRotator& Rotation)
 	}
 }
 
+uint32 AFlybotMapRoom::GetTubeLightClusterSize(uint32 TubeSize) const
+{
+	uint32 ClusterSize = 0;
+	switch (TubeLightMode)
+	{
+	case EFlybotTubeLightMode::PerSegment:
+		ClusterSize = 1;
+		break;
+	case EFlybotTubeLightMode::Clustered:
+		ClusterSize = FMath::Max(TubeLightClusterSize, 1u);
+		break;
+	}
+
+	// Too many lights for this tube, so widen the clusters to stay within the budget.
+	uint32 ClusterBudget = FMath::DivideAndRoundUp(TubeSize - 1, FMath::Max(MaxLightsPerTube, 1u));
+	return FMath::Max(ClusterSize, ClusterBudget);
+}
+
 template<class T>
 T* AFlybotMapRoom::AddComponent(const FTransform& Transform)
 {
@@ -262,17 +682,19 @@ T* AFlybotMapRoom::AddComponent(const FTransform& Transform)
 void AFlybotMapRoom::AddCollisionBox(const FVector& Extent, const FRotator& Rotation,
 	const FVector& Translation, const FRotator& FaceRotation)
 {
-	UBoxComponent* Box = AddComponent<UBoxComponent>(
-		FTransform(Rotation + FaceRotation, Rotation.RotateVector(Translation)));
-	Box->SetCollisionProfileName(TEXT("BlockAll"));
-	Box->SetBoxExtent(Extent);
+	Collision->AddBox(Extent, FTransform(Rotation + FaceRotation, Rotation.RotateVector(Translation)), CurrentPart);
 }
 
 void AFlybotMapRoom::AddPointLight(float Intensity, float Radius,
 	const FRotator& Rotation, const FVector& Translation)
 {
+	// Dedicated servers never render, so don't spend components on lights.
+	if (IsRunningDedicatedServer())
+		return;
+
 	UPointLightComponent* Light = AddComponent<UPointLightComponent>(
 		FTransform(Rotation, Rotation.RotateVector(Translation)));
+	Parts[CurrentPart].Lights.Add(Light);
 	Light->Intensity = Intensity;
 	Light->SetAttenuationRadius(Radius);
 	Light->SetSoftSourceRadius(Radius);
@@ -6,6 +6,34 @@
 #include "GameFramework/Actor.h"
 #include "FlybotMapRoom.generated.h"
 
+/** How tubes are lit between the lights at each tube entrance. */
+UENUM()
+enum class EFlybotTubeLightMode : uint8
+{
+	/** One point light for every tube segment. */
+	PerSegment,
+
+	/** One point light for every TubeLightClusterSize tube segments. */
+	Clustered
+};
+
+/** Components built for one part of a room, either a tube direction or the rest of the room. */
+USTRUCT()
+struct FFlybotMapRoomPart
+{
+	GENERATED_BODY()
+
+	/** Tube size the part was built with, always 0 for the rest of the room. */
+	UPROPERTY()
+	uint32 TubeSize;
+
+	/** Point lights added for the part. */
+	UPROPERTY()
+	TArray<class UPointLightComponent*> Lights;
+
+	FFlybotMapRoomPart();
+};
+
 UCLASS()
 class FLYBOT_API AFlybotMapRoom : public AActor
 {
@@ -22,25 +50,41 @@ public:
 	/** Build or rebuild the room if needed. */
 	virtual void OnConstruction(const FTransform& Transform) override;
 
+	/** Add the room to the analytic map geometry. */
+	virtual void BeginPlay() override;
+
+	/** Remove the room from the analytic map geometry. */
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	/** World space bounds of the room walls, and optionally the tubes extending from them. */
+	FBox GetRoomBounds(bool bIncludeTubes) const;
+
+	/** World space start and end points along the center of each tube extending from the room. */
+	void GetTubes(TArray<FVector>& OutStarts, TArray<FVector>& OutEnds) const;
+
 	/** Static mesh to use for walls. */
 	UPROPERTY(EditAnywhere)
-	class UInstancedStaticMeshComponent* Walls;
+	class UHierarchicalInstancedStaticMeshComponent* Walls;
 
 	/** Static mesh to use for edges where two walls meet. */
 	UPROPERTY(EditAnywhere)
-	class UInstancedStaticMeshComponent* Edges;
+	class UHierarchicalInstancedStaticMeshComponent* Edges;
 
 	/** Static mesh to use for corners where three edges meet. */
 	UPROPERTY(EditAnywhere)
-	class UInstancedStaticMeshComponent* Corners;
+	class UHierarchicalInstancedStaticMeshComponent* Corners;
 
 	/** Static mesh to use for walls where tubes exit room. */
 	UPROPERTY(EditAnywhere)
-	class UInstancedStaticMeshComponent* TubeWalls;
+	class UHierarchicalInstancedStaticMeshComponent* TubeWalls;
 
 	/** Static mesh to use for tubes extending from tube walls. */
 	UPROPERTY(EditAnywhere)
-	class UInstancedStaticMeshComponent* Tubes;
+	class UHierarchicalInstancedStaticMeshComponent* Tubes;
+
+	/** Collision boxes for walls, edges and tubes, merged into one physics body. */
+	UPROPERTY(EditAnywhere)
+	class UFlybotMapRoomCollision* Collision;
 
 	/** Size of grid to use when placing meshes. */
 	UPROPERTY(EditAnywhere, meta = (ClampMin = 0, RebuildMapRoom))
@@ -70,6 +114,22 @@ public:
 	UPROPERTY(EditAnywhere, meta = (ClampMin = 0, RebuildMapRoom))
 	float TubeCollisionThickness;
 
+	/** How to light tube segments. */
+	UPROPERTY(EditAnywhere, meta = (RebuildMapRoom))
+	EFlybotTubeLightMode TubeLightMode;
+
+	/** How many tube segments share one light in clustered mode. */
+	UPROPERTY(EditAnywhere, meta = (ClampMin = 1, ClampMax = 100, RebuildMapRoom))
+	uint32 TubeLightClusterSize;
+
+	/** Most point lights to add to one tube, longer tubes share each light between more segments. */
+	UPROPERTY(EditAnywhere, meta = (ClampMin = 1, ClampMax = 1000, RebuildMapRoom))
+	uint32 MaxLightsPerTube;
+
+	/** Largest attenuation radius for a tube light, so clusters widened by MaxLightsPerTube stay cheap. */
+	UPROPERTY(EditAnywhere, meta = (ClampMin = 0, RebuildMapRoom))
+	float MaxTubeLightRadius;
+
 	/** How many tubes to extend off the center positive X wall, if any (0 to disable). */
 	UPROPERTY(EditAnywhere, meta = (ClampMax = 1000, RebuildMapRoom))
 	uint32 PositiveXTubeSize;
@@ -101,8 +161,91 @@ private:
 	/** Distance from the center of the room to walls. */
 	int32 WallOffset;
 
-	/** Add section of tubes with lights and collision boxes. */
-	void AddTubeInstances(uint32 TubeSize, const FRotator& Rotation);
+	/**
+	 * Parts the room is built from, so changing one tube only rebuilds that tube. The first six are
+	 * the tube directions in the order positive X, negative X, positive Y, negative Y, positive Z,
+	 * negative Z, and the last is everything else.
+	 */
+	UPROPERTY()
+	FFlybotMapRoomPart Parts[7];
+
+	/** Index of the part for everything that isn't a tube. */
+	static constexpr uint8 ShellPart = 6;
+
+	/** Part being built, which added instances, lights and collision boxes belong to. */
+	uint8 CurrentPart;
+
+	/** Hash of the properties every part depends on, from the last full build. */
+	UPROPERTY()
+	uint32 BuiltShellHash;
+
+	/** Part that added each wall instance. */
+	UPROPERTY()
+	TArray<uint8> WallParts;
+
+	/** Part that added each tube wall instance. */
+	UPROPERTY()
+	TArray<uint8> TubeWallParts;
+
+	/** Part that added each tube instance. */
+	UPROPERTY()
+	TArray<uint8> TubeParts;
+
+	/** Hash of the properties every part depends on, which need a full build when changed. */
+	uint32 GetShellHash() const;
+
+	/** Whether the parts saved with the room match its instances, so it can be rebuilt incrementally. */
+	bool CanRebuildIncrementally() const;
+
+	/** Clear everything and build all parts. */
+	void BuildFull();
+
+	/** Rebuild only the tube parts whose size changed, returning how many were rebuilt. */
+	int32 BuildIncremental();
+
+	/** Add walls, edges, corners and edge collision, everything except the tubes. */
+	void AddShellInstances();
+
+	/** Remove the instances, lights and collision boxes added for a part. */
+	void RemovePart(uint8 Part);
+
+	/** Remove the instances added for a part, moving the last instances into the gaps. */
+	void RemovePartInstances(class UInstancedStaticMeshComponent* Component, TArray<uint8>& InstanceParts, uint8 Part);
+
+	/** Part tracking array for a component, or null if only the shell adds to it. */
+	TArray<uint8>* GetInstanceParts(class UInstancedStaticMeshComponent* Component);
+
+	/** Instances waiting to be added to one component. */
+	struct FPendingInstances
+	{
+		/** Translations before rotating. */
+		TArray<FVector> Translations;
+
+		/** Axis aligned orientation of each instance. */
+		TArray<uint8> Orientations;
+	};
+
+	/** Instances to add to each component in one batch once the parts are built. */
+	TMap<class UInstancedStaticMeshComponent*, FPendingInstances> PendingInstances;
+
+	/** Queue a mesh instance for the current part, Rotation must be axis aligned. */
+	void AddInstance(class UInstancedStaticMeshComponent* Component,
+		const FRotator& Rotation, const FVector& Translation);
+
+	/** Compute transforms for all queued instances and add them to their components. */
+	void AddPendingInstances();
+
+	/** Tube size property for a direction. */
+	uint32 GetTubeSize(int32 Direction) const;
+
+	/** Total number of point lights in all parts. */
+	int32 GetNumLights() const;
+
+	/** Number of tube segments sharing each light for a tube. */
+	uint32 GetTubeLightClusterSize(uint32 TubeSize) const;
+
+	/** Add the center wall for a direction, with the tube, lights and collision boxes if it has one. */
+	void AddTubeInstances(int32 Direction);
 
 	/** Helper function to add new components. */
 	template<class T>
@@ -0,0 +1,98 @@
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+#include "FlybotMapRoomCollision.h"
+#include "PhysicsEngine/BodySetup.h"
+
+UFlybotMapRoomCollision::UFlybotMapRoomCollision()
+{
+	PrimaryComponentTick.bCanEverTick = false;
+	BodySetup = nullptr;
+	SetCollisionProfileName(TEXT("BlockAll"));
+	SetGenerateOverlapEvents(false);
+	bHiddenInGame = true;
+	bUseAsOccluder = false;
+}
+
+UBodySetup* UFlybotMapRoomCollision::GetBodySetup()
+{
+	CreateBodySetup();
+	return BodySetup;
+}
+
+FBoxSphereBounds UFlybotMapRoomCollision::CalcBounds(const FTransform& LocalToWorld) const
+{
+	if (!BodySetup || BodySetup->AggGeom.BoxElems.Num() == 0)
+		return FBoxSphereBounds(LocalToWorld.GetLocation(), FVector::ZeroVector, 0.f);
+
+	FBox Bounds(ForceInit);
+	for (const FKBoxElem& Box : BodySetup->AggGeom.BoxElems)
+	{
+		Bounds += Box.CalcAABB(LocalToWorld, 1.f);
+	}
+
+	return FBoxSphereBounds(Bounds);
+}
+
+void UFlybotMapRoomCollision::ClearBoxes()
+{
+	CreateBodySetup();
+	BodySetup->AggGeom.BoxElems.Reset();
+	BoxParts.Reset();
+}
+
+void UFlybotMapRoomCollision::AddBox(const FVector& Extent, const FTransform& Transform, uint8 Part)
+{
+	CreateBodySetup();
+	BoxParts.Add(Part);
+
+	// Box elements use the full size, not the extent.
+	FKBoxElem& Box = BodySetup->AggGeom.BoxElems.Emplace_GetRef(
+		Extent.X * 2.f, Extent.Y * 2.f, Extent.Z * 2.f);
+	Box.SetTransform(Transform);
+}
+
+void UFlybotMapRoomCollision::RemoveBoxes(uint8 Part)
+{
+	CreateBodySetup();
+
+	// Boxes saved before parts were tracked are treated as part 0.
+	TArray<FKBoxElem>& Boxes = BodySetup->AggGeom.BoxElems;
+	BoxParts.SetNumZeroed(Boxes.Num());
+
+	for (int32 Index = Boxes.Num() - 1; Index >= 0; Index--)
+	{
+		if (BoxParts[Index] == Part)
+		{
+			Boxes.RemoveAtSwap(Index, 1, false);
+			BoxParts.RemoveAtSwap(Index, 1, false);
+		}
+	}
+}
+
+void UFlybotMapRoomCollision::UpdateCollision()
+{
+	CreateBodySetup();
+
+	// Boxes don't need cooking, but the body has to be rebuilt from the new elements.
+	BodySetup->InvalidatePhysicsData();
+	BodySetup->CreatePhysicsMeshes();
+	RecreatePhysicsState();
+	UpdateBounds();
+}
+
+int32 UFlybotMapRoomCollision::GetNumBoxes() const
+{
+	return BodySetup ? BodySetup->AggGeom.BoxElems.Num() : 0;
+}
+
+void UFlybotMapRoomCollision::CreateBodySetup()
+{
+	if (BodySetup)
+		return;
+
+	BodySetup = NewObject<UBodySetup>(this, NAME_None, RF_Transactional);
+	BodySetup->BodySetupGuid = FGuid::NewGuid();
+	BodySetup->CollisionTraceFlag = CTF_UseSimpleAsComplex;
+	BodySetup->bGenerateMirroredCollision = false;
+	BodySetup->bDoubleSidedGeometry = true;
+}
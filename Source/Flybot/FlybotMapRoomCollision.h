@@ -0,0 +1,54 @@
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/PrimitiveComponent.h"
+#include "FlybotMapRoomCollision.generated.h"
+
+/**
+ * Collision for a whole map room as a single physics body. Boxes are gathered while the room is
+ * built and then created together in one body setup, instead of registering a component and a
+ * physics body for every wall section.
+ */
+UCLASS()
+class FLYBOT_API UFlybotMapRoomCollision : public UPrimitiveComponent
+{
+	GENERATED_BODY()
+
+public:
+	UFlybotMapRoomCollision();
+
+	/** Body setup holding all of the collision boxes. */
+	virtual UBodySetup* GetBodySetup() override;
+
+	/** Bounds of all of the collision boxes. */
+	virtual FBoxSphereBounds CalcBounds(const FTransform& LocalToWorld) const override;
+
+	/** Remove all collision boxes, call UpdateCollision once new boxes are added. */
+	void ClearBoxes();
+
+	/** Add a collision box relative to this component, tagged with the part of the room that added it. */
+	void AddBox(const FVector& Extent, const FTransform& Transform, uint8 Part = 0);
+
+	/** Remove the collision boxes added by one part of the room, call UpdateCollision afterwards. */
+	void RemoveBoxes(uint8 Part);
+
+	/** Recreate the physics body from the current boxes. */
+	void UpdateCollision();
+
+	/** Number of collision boxes in the body. */
+	int32 GetNumBoxes() const;
+
+private:
+	/** Body setup holding all of the collision boxes. */
+	UPROPERTY()
+	class UBodySetup* BodySetup;
+
+	/** Part of the room that added each box in the body setup. */
+	UPROPERTY()
+	TArray<uint8> BoxParts;
+
+	/** Create the body setup if it doesn't exist yet. */
+	void CreateBodySetup();
+};
@@ -0,0 +1,61 @@
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+#include "FlybotMoveValidator.h"
+#include "Flybot.h"
+#include "FlybotPlayerPawn.h"
+#include "Async/ParallelFor.h"
+
+DECLARE_CYCLE_STAT(TEXT("Move Validator Tick"), STAT_FlybotMoveValidatorTick, STATGROUP_Flybot);
+DECLARE_CYCLE_STAT(TEXT("Move Validator Validate"), STAT_FlybotMoveValidatorValidate, STATGROUP_Flybot);
+DECLARE_CYCLE_STAT(TEXT("Move Validator Apply"), STAT_FlybotMoveValidatorApply, STATGROUP_Flybot);
+
+UFlybotMoveValidator::UFlybotMoveValidator()
+{
+	ParallelPawnThreshold = 4;
+}
+
+bool UFlybotMoveValidator::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UFlybotMoveValidator::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UFlybotMoveValidator, STATGROUP_Tickables);
+}
+
+void UFlybotMoveValidator::QueuePawn(AFlybotPlayerPawn* Pawn)
+{
+	QueuedPawns.AddUnique(Pawn);
+}
+
+void UFlybotMoveValidator::Tick(float DeltaTime)
+{
+	FLYBOT_SCOPE_CYCLE_COUNTER(STAT_FlybotMoveValidatorTick);
+
+	// Pawns may have been destroyed since queuing moves.
+	QueuedPawns.RemoveAllSwap([](AFlybotPlayerPawn* Pawn) { return !IsValid(Pawn); }, false);
+	if (QueuedPawns.Num() == 0)
+		return;
+
+	// Each pawn only touches its own state here, and the sweeps are read-only scene queries, so
+	// pawns can be validated in parallel.
+	{
+		FLYBOT_SCOPE_CYCLE_COUNTER(STAT_FlybotMoveValidatorValidate);
+		ParallelFor(QueuedPawns.Num(), [this](int32 Index)
+		{
+			QueuedPawns[Index]->ValidateServerMoves();
+		}, QueuedPawns.Num() < ParallelPawnThreshold);
+	}
+
+	// Moving components and sending RPCs has to happen on the game thread.
+	{
+		FLYBOT_SCOPE_CYCLE_COUNTER(STAT_FlybotMoveValidatorApply);
+		for (AFlybotPlayerPawn* Pawn : QueuedPawns)
+		{
+			Pawn->ApplyServerMoves();
+		}
+	}
+
+	QueuedPawns.Reset();
+}
\ No newline at end of file
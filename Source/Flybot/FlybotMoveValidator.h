@@ -0,0 +1,42 @@
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "FlybotMoveValidator.generated.h"
+
+/**
+ * Validates client moves for all pawns in one batch per server tick. Moves received through RPCs are
+ * queued on each pawn, then speed checks and collision sweeps run in parallel across pawns since they
+ * only read from the physics scene. The results are applied to the pawns on the game thread.
+ */
+UCLASS()
+class FLYBOT_API UFlybotMoveValidator : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	UFlybotMoveValidator();
+
+	/** Only validate moves in worlds where gameplay actually runs. */
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	/** Validate and apply all queued moves. */
+	virtual void Tick(float DeltaTime) override;
+
+	/** Stat used when ticking the subsystem. */
+	virtual TStatId GetStatId() const override;
+
+	/** Validate the pawn's queued moves on the next tick. */
+	void QueuePawn(class AFlybotPlayerPawn* Pawn);
+
+	/** Validate pawns on multiple threads when at least this many have queued moves. */
+	UPROPERTY(EditAnywhere)
+	int32 ParallelPawnThreshold;
+
+private:
+	/** Pawns with queued moves. */
+	UPROPERTY()
+	TArray<class AFlybotPlayerPawn*> QueuedPawns;
+};
\ No newline at end of file
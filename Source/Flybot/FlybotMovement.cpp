@@ -0,0 +1,238 @@
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+#include "FlybotMovement.h"
+#include "Engine/NetSerialization.h"
+
+/** Positions are sent with 0.1 unit precision. */
+static constexpr int32 MovePositionScale = 10;
+
+/** Timestamps after the first move in a packet are sent as millisecond deltas. */
+static constexpr float MoveTimestampScale = 1000.f;
+
+FFlybotSavedMove::FFlybotSavedMove()
+{
+	Sequence = 0;
+	Timestamp = 0.f;
+	Position = FVector::ZeroVector;
+	Rotation = FRotator::ZeroRotator;
+}
+
+FFlybotMovePacket::FFlybotMovePacket()
+{
+	BaseSequence = 0;
+	bAbsolute = true;
+	CorrectionId = 0;
+}
+
+FVector FFlybotMovePacket::QuantizePosition(const FVector& Position)
+{
+	return FVector(
+		FMath::RoundToFloat(Position.X * MovePositionScale) / MovePositionScale,
+		FMath::RoundToFloat(Position.Y * MovePositionScale) / MovePositionScale,
+		FMath::RoundToFloat(Position.Z * MovePositionScale) / MovePositionScale);
+}
+
+void FFlybotMovePacket::AddMove(const FFlybotSavedMove& Move, const FVector& PreviousPosition)
+{
+	FFlybotSavedMove& Added = Moves.Add_GetRef(Move);
+	Added.Position = QuantizePosition(Move.Position - PreviousPosition);
+}
+
+void FFlybotMovePacket::ResolvePositions(const FVector& BasePosition)
+{
+	FVector Position = BasePosition;
+	for (FFlybotSavedMove& Move : Moves)
+	{
+		// Quantize again to remove any float error from adding the delta.
+		Position = QuantizePosition(Position + Move.Position);
+		Move.Position = Position;
+	}
+}
+
+bool FFlybotMovePacket::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+	bOutSuccess = true;
+
+	uint8 bAbsoluteBit = bAbsolute;
+	Ar.SerializeBits(&bAbsoluteBit, 1);
+	bAbsolute = bAbsoluteBit;
+
+	if (!bAbsolute)
+	{
+		Ar << BaseSequence;
+	}
+
+	Ar.SerializeBits(&CorrectionId, CorrectionIdBits);
+
+	uint32 NumMoves = Moves.Num();
+	Ar.SerializeInt(NumMoves, MaxMoves + 1);
+	if (Ar.IsLoading())
+	{
+		Moves.SetNum(NumMoves);
+	}
+
+	for (int32 a = 0; a < Moves.Num(); a++)
+	{
+		FFlybotSavedMove& Move = Moves[a];
+
+		// Sequences are consecutive, and timestamps are close together, so only the first move
+		// needs the full values.
+		if (a == 0)
+		{
+			Ar << Move.Sequence;
+			Ar << Move.Timestamp;
+		}
+		else
+		{
+			Move.Sequence = Moves[a - 1].Sequence + 1;
+
+			uint16 TimestampDelta = FMath::Clamp(FMath::RoundToInt(
+				(Move.Timestamp - Moves[a - 1].Timestamp) * MoveTimestampScale), 0, int32(MAX_uint16));
+			Ar << TimestampDelta;
+			Move.Timestamp = Moves[a - 1].Timestamp + TimestampDelta / MoveTimestampScale;
+		}
+
+		// Deltas are small and only use as many bits as they need, absolute positions need room for
+		// the whole map.
+		if (a == 0 && bAbsolute)
+		{
+			bOutSuccess &= SerializePackedVector<MovePositionScale, 30>(Move.Position, Ar);
+		}
+		else
+		{
+			bOutSuccess &= SerializePackedVector<MovePositionScale, 24>(Move.Position, Ar);
+		}
+
+		Move.Rotation.SerializeCompressedShort(Ar);
+	}
+
+	return true;
+}
+
+FFlybotMoveCorrection::FFlybotMoveCorrection()
+{
+	Sequence = 0;
+	Id = 0;
+	Position = FVector::ZeroVector;
+	Rotation = FRotator::ZeroRotator;
+}
+
+FFlybotMoveHistory::FFlybotMoveHistory()
+{
+	Reset();
+}
+
+void FFlybotMoveHistory::Add(uint16 Sequence, const FVector& Position)
+{
+	int32 Index = Sequence % Size;
+	Positions[Index] = Position;
+	Sequences[Index] = Sequence;
+	bValid[Index] = true;
+}
+
+const FVector* FFlybotMoveHistory::Find(uint16 Sequence) const
+{
+	int32 Index = Sequence % Size;
+	return bValid[Index] && Sequences[Index] == Sequence ? &Positions[Index] : nullptr;
+}
+
+void FFlybotMoveHistory::Reset()
+{
+	for (int32 a = 0; a < Size; a++)
+	{
+		bValid[a] = false;
+	}
+}
+
+FFlybotInterpolationBuffer::FFlybotInterpolationBuffer()
+{
+	Reset();
+}
+
+void FFlybotInterpolationBuffer::Add(float Time, const FVector& Location, const FQuat& Rotation)
+{
+	if (Count > 0 && Time <= Get(Count - 1).Time)
+	{
+		// Several updates in one frame, only the last one matters.
+		Count--;
+	}
+	else if (Count == Size)
+	{
+		Start = (Start + 1) % Size;
+		Count--;
+	}
+
+	FSnapshot& Snapshot = Snapshots[(Start + Count) % Size];
+	Snapshot.Time = Time;
+	Snapshot.Location = Location;
+	Snapshot.Rotation = Rotation;
+	Count++;
+}
+
+FVector FFlybotInterpolationBuffer::GetTangent(int32 Index) const
+{
+	int32 Previous = FMath::Max(Index - 1, 0);
+	int32 Next = FMath::Min(Index + 1, Count - 1);
+	float Elapsed = Get(Next).Time - Get(Previous).Time;
+	return Elapsed > 0.f ? (Get(Next).Location - Get(Previous).Location) / Elapsed : FVector::ZeroVector;
+}
+
+bool FFlybotInterpolationBuffer::Sample(float Time, float MaxExtrapolation, FVector& OutLocation,
+	FQuat& OutRotation) const
+{
+	if (Count == 0)
+		return false;
+
+	const FSnapshot& Oldest = Get(0);
+	if (Time <= Oldest.Time)
+	{
+		OutLocation = Oldest.Location;
+		OutRotation = Oldest.Rotation;
+		return true;
+	}
+
+	const FSnapshot& Newest = Get(Count - 1);
+	if (Time >= Newest.Time)
+	{
+		// Extrapolating past where the pawn stopped would leave it there, possibly inside a wall, so
+		// after MaxExtrapolation come back to the newest snapshot.
+		float Elapsed = Time - Newest.Time;
+		float Extrapolation = 0.f;
+		if (Elapsed <= MaxExtrapolation)
+		{
+			Extrapolation = Elapsed;
+		}
+		else if (Elapsed < MaxExtrapolation * 2.f)
+		{
+			Extrapolation = MaxExtrapolation * 2.f - Elapsed;
+		}
+
+		OutLocation = Newest.Location + GetTangent(Count - 1) * Extrapolation;
+		OutRotation = Newest.Rotation;
+		return true;
+	}
+
+	// Find the snapshots on either side of the sample time, there are only a few so search linearly.
+	int32 Index = 0;
+	while (Get(Index + 1).Time < Time)
+	{
+		Index++;
+	}
+
+	const FSnapshot& From = Get(Index);
+	const FSnapshot& To = Get(Index + 1);
+	float Duration = To.Time - From.Time;
+	float Alpha = (Time - From.Time) / Duration;
+
+	// Tangents are velocities, scale them to the length of this segment.
+	OutLocation = FMath::CubicInterp(From.Location, GetTangent(Index) * Duration, To.Location,
+		GetTangent(Index + 1) * Duration, Alpha);
+	OutRotation = FQuat::Slerp(From.Rotation, To.Rotation, Alpha);
+	return true;
+}
+
+void FFlybotInterpolationBuffer::Reset()
+{
+	Start = 0;
+	Count = 0;
+}
@@ -0,0 +1,209 @@
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/NetSerialization.h"
+#include "FlybotMovement.generated.h"
+
+/** Whether move sequence A comes after B, allowing for the sequence to wrap around. */
+static FORCEINLINE bool IsNewerMoveSequence(uint16 A, uint16 B)
+{
+	return int16(A - B) > 0;
+}
+
+/** A timestamped transform recorded by the client, kept until the server acknowledges it. */
+USTRUCT()
+struct FLYBOT_API FFlybotSavedMove
+{
+	GENERATED_BODY()
+
+	/** Sequence number of this move. */
+	uint16 Sequence;
+
+	/** Client time the move was recorded. */
+	float Timestamp;
+
+	/** Position at the end of the move, quantized with FFlybotMovePacket::QuantizePosition. */
+	FVector Position;
+
+	/** Rotation at the end of the move. */
+	FRotator Rotation;
+
+	FFlybotSavedMove();
+};
+
+/**
+ * Compact batch of consecutive moves sent from the client to the server. Every unacknowledged
+ * move is sent again in following packets, so a lost packet does not lose any moves. The first
+ * position is relative to a move the server has already acknowledged, and each following position
+ * is relative to the one before it, so positions usually fit in a few bits per component. Rotations
+ * are packed into shorts and scale is not sent since it never changes.
+ */
+USTRUCT()
+struct FLYBOT_API FFlybotMovePacket
+{
+	GENERATED_BODY()
+
+	/** Most moves that fit in a packet. */
+	static constexpr int32 MaxMoves = 16;
+
+	/** Bits used to send the correction ID, IDs wrap around at this size. */
+	static constexpr int32 CorrectionIdBits = 4;
+
+	/** Sequence number of the acknowledged move the first position is relative to. */
+	uint16 BaseSequence;
+
+	/** Whether the first position is absolute because no move has been acknowledged yet. */
+	bool bAbsolute;
+
+	/**
+	 * ID of the last correction the client applied. Moves predicted before that correction start from
+	 * the wrong place, so the server drops packets that don't carry its latest ID.
+	 */
+	uint8 CorrectionId;
+
+	/**
+	 * Moves with consecutive sequence numbers, oldest first. Each position is the quantized delta from
+	 * the previous move, or from the base for the first move.
+	 */
+	TArray<FFlybotSavedMove, TInlineAllocator<MaxMoves>> Moves;
+
+	FFlybotMovePacket();
+
+	/**
+	 * Round a position to the precision used on the wire. Saved moves are quantized when they are
+	 * recorded, so the server rebuilds exactly the same positions no matter which base was used.
+	 */
+	static FVector QuantizePosition(const FVector& Position);
+
+	/** Add a saved move, storing its position as a delta from PreviousPosition. */
+	void AddMove(const FFlybotSavedMove& Move, const FVector& PreviousPosition);
+
+	/** Turn the position deltas back into positions, starting from the base position. */
+	void ResolvePositions(const FVector& BasePosition);
+
+	/** Custom serialization to quantize and pack the moves. */
+	bool NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess);
+};
+
+template<>
+struct TStructOpsTypeTraits<FFlybotMovePacket> : public TStructOpsTypeTraitsBase2<FFlybotMovePacket>
+{
+	enum
+	{
+		WithNetSerializer = true,
+	};
+};
+
+/**
+ * Where the server put the pawn after a move it rejected. The client resets to this position and
+ * replays its moves newer than Sequence from there, so a correction only moves the pawn by the
+ * difference between the server and client results instead of snapping it back in time.
+ */
+USTRUCT()
+struct FLYBOT_API FFlybotMoveCorrection
+{
+	GENERATED_BODY()
+
+	/** Sequence number of the move that was corrected, the server continues from this move. */
+	UPROPERTY()
+	uint16 Sequence;
+
+	/** Incremented for every correction, wrapping at FFlybotMovePacket::CorrectionIdBits. */
+	UPROPERTY()
+	uint8 Id;
+
+	/** Corrected position, quantized with FFlybotMovePacket::QuantizePosition. */
+	UPROPERTY()
+	FVector_NetQuantize10 Position;
+
+	/** Corrected rotation. */
+	UPROPERTY()
+	FRotator Rotation;
+
+	FFlybotMoveCorrection();
+};
+
+/**
+ * Positions of recent moves by sequence number. The client uses this to find the base of each
+ * delta, and the server uses it to rebuild the absolute position from the delta.
+ */
+struct FLYBOT_API FFlybotMoveHistory
+{
+	/** How many moves to remember, which bounds how old an acknowledged base can be. */
+	static constexpr int32 Size = 256;
+
+	FFlybotMoveHistory();
+
+	/** Remember the position for a move, replacing the move Size sequences before it. */
+	void Add(uint16 Sequence, const FVector& Position);
+
+	/** Position for a move, or nullptr if we don't have it anymore. */
+	const FVector* Find(uint16 Sequence) const;
+
+	/** Forget all moves. */
+	void Reset();
+
+private:
+	FVector Positions[Size];
+	uint16 Sequences[Size];
+	bool bValid[Size];
+};
+
+/**
+ * Recent transforms received for a simulated pawn, sampled a little in the past so there is usually
+ * a snapshot on both sides of the sample time. Positions are interpolated with cubic Hermite curves
+ * using tangents from the neighboring snapshots, so paths stay smooth with few updates per second.
+ */
+struct FLYBOT_API FFlybotInterpolationBuffer
+{
+	/** How many snapshots to keep, enough for the interpolation delay at the lowest update rate. */
+	static constexpr int32 Size = 8;
+
+	FFlybotInterpolationBuffer();
+
+	/** Add a snapshot received at Time, replacing the newest one if it was received at the same time. */
+	void Add(float Time, const FVector& Location, const FQuat& Rotation);
+
+	/**
+	 * Transform at Time, returning false if there are no snapshots. Past the newest snapshot the last
+	 * velocity is extrapolated for at most MaxExtrapolation seconds, then the pawn blends back to the
+	 * newest snapshot over the same time, since a pawn that stopped sends no more updates.
+	 */
+	bool Sample(float Time, float MaxExtrapolation, FVector& OutLocation, FQuat& OutRotation) const;
+
+	/** Number of snapshots in the buffer. */
+	int32 Num() const { return Count; }
+
+	/** Receive time of the newest snapshot. */
+	float GetNewestTime() const { return Get(Count - 1).Time; }
+
+	/** Receive time and location of a snapshot, oldest first. */
+	float GetTime(int32 Index) const { return Get(Index).Time; }
+	const FVector& GetLocation(int32 Index) const { return Get(Index).Location; }
+
+	/** Forget all snapshots. */
+	void Reset();
+
+private:
+	struct FSnapshot
+	{
+		float Time;
+		FVector Location;
+		FQuat Rotation;
+	};
+
+	const FSnapshot& Get(int32 Index) const { return Snapshots[(Start + Index) % Size]; }
+
+	/** Velocity at a snapshot, from the snapshots on either side of it. */
+	FVector GetTangent(int32 Index) const;
+
+	FSnapshot Snapshots[Size];
+
+	/** Index of the oldest snapshot. */
+	int32 Start;
+
+	/** Number of valid snapshots. */
+	int32 Count;
+};
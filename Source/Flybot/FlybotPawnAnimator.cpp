@@ -0,0 +1,186 @@
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+#include "FlybotPawnAnimator.h"
+#include "Flybot.h"
+#include "FlybotPlayerPawn.h"
+#include "Camera/PlayerCameraManager.h"
+#include "Components/StaticMeshComponent.h"
+#include "GameFramework/PlayerController.h"
+
+DECLARE_CYCLE_STAT(TEXT("Pawn Animation"), STAT_FlybotPawnAnimation, STATGROUP_Flybot);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Animated Pawns"), STAT_FlybotAnimatedPawns, STATGROUP_Flybot);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Skipped Pawn Animations"), STAT_FlybotSkippedPawnAnimations, STATGROUP_Flybot);
+
+UFlybotPawnAnimator::UFlybotPawnAnimator()
+{
+	NearDistance = 5000.f;
+	MidDistance = 20000.f;
+	FarUpdateInterval = 4;
+	MaxDistance = 40000.f;
+	OffScreenTime = 0.2f;
+}
+
+bool UFlybotPawnAnimator::ShouldCreateSubsystem(UObject* Outer) const
+{
+	return !IsRunningDedicatedServer() && Super::ShouldCreateSubsystem(Outer);
+}
+
+bool UFlybotPawnAnimator::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UFlybotPawnAnimator::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UFlybotPawnAnimator, STATGROUP_Tickables);
+}
+
+void UFlybotPawnAnimator::RegisterPawn(AFlybotPlayerPawn* Pawn)
+{
+	if (Pawns.Contains(Pawn))
+		return;
+
+	Pawns.Add(Pawn);
+	Bodies.Add(Pawn->Body);
+	Heads.Add(Pawn->Head);
+	BaseRotations.Add(Pawn->Body->GetRelativeRotation());
+	ZAmplitudes.Add(Pawn->ZMovementAmplitude);
+	ZFrequencies.Add(Pawn->ZMovementFrequency);
+	ZOffsets.Add(Pawn->ZMovementOffset);
+	TiltMaxes.Add(Pawn->TiltMax);
+	TiltResetScales.Add(Pawn->TiltResetScale);
+	Rolls.Add(0.f);
+	FramesSinceUpdate.Add(0);
+}
+
+void UFlybotPawnAnimator::UnregisterPawn(AFlybotPlayerPawn* Pawn)
+{
+	int32 Index = Pawns.Find(Pawn);
+	if (Index != INDEX_NONE)
+	{
+		RemovePawnAtSwap(Index);
+	}
+}
+
+void UFlybotPawnAnimator::RemovePawnAtSwap(int32 Index)
+{
+	Pawns.RemoveAtSwap(Index, 1, false);
+	Bodies.RemoveAtSwap(Index, 1, false);
+	Heads.RemoveAtSwap(Index, 1, false);
+	BaseRotations.RemoveAtSwap(Index, 1, false);
+	ZAmplitudes.RemoveAtSwap(Index, 1, false);
+	ZFrequencies.RemoveAtSwap(Index, 1, false);
+	ZOffsets.RemoveAtSwap(Index, 1, false);
+	TiltMaxes.RemoveAtSwap(Index, 1, false);
+	TiltResetScales.RemoveAtSwap(Index, 1, false);
+	Rolls.RemoveAtSwap(Index, 1, false);
+	FramesSinceUpdate.RemoveAtSwap(Index, 1, false);
+}
+
+int32 UFlybotPawnAnimator::GetUpdateInterval(int32 Index,
+	const TArray<FVector, TInlineAllocator<4>>& ViewLocations) const
+{
+	// Always animate our own pawn, since the tilt follows our input.
+	const AFlybotPlayerPawn* Pawn = Pawns[Index];
+	if (Pawn->IsLocallyControlled() || ViewLocations.Num() == 0)
+		return 1;
+
+	if (!Pawn->WasRecentlyRendered(OffScreenTime))
+		return 0;
+
+	FVector Location = Pawn->GetActorLocation();
+	float DistanceSquared = TNumericLimits<float>::Max();
+	for (const FVector& ViewLocation : ViewLocations)
+	{
+		DistanceSquared = FMath::Min(DistanceSquared, float(FVector::DistSquared(Location, ViewLocation)));
+	}
+
+	if (MaxDistance > 0.f && DistanceSquared > FMath::Square(MaxDistance))
+		return 0;
+
+	if (DistanceSquared <= FMath::Square(NearDistance))
+		return 1;
+
+	return DistanceSquared <= FMath::Square(MidDistance) ? 2 : FarUpdateInterval;
+}
+
+void UFlybotPawnAnimator::Tick(float DeltaTime)
+{
+	FLYBOT_SCOPE_CYCLE_COUNTER(STAT_FlybotPawnAnimation);
+
+	// Pawns may have been destroyed without ending play, such as when the world is torn down.
+	for (int32 Index = Pawns.Num() - 1; Index >= 0; Index--)
+	{
+		if (!IsValid(Pawns[Index]))
+		{
+			RemovePawnAtSwap(Index);
+		}
+	}
+
+	TArray<FVector, TInlineAllocator<4>> ViewLocations;
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		const APlayerController* PlayerController = It->Get();
+		if (PlayerController && PlayerController->IsLocalController() && PlayerController->PlayerCameraManager)
+		{
+			ViewLocations.Add(PlayerController->PlayerCameraManager->GetCameraLocation());
+		}
+	}
+
+	// Pick the pawns due for an update, and take the tilt input they gathered since the last one.
+	UpdateIndices.Reset();
+	UpdateFrames.Reset();
+	UpdateTiltInputs.Reset();
+	for (int32 Index = 0; Index < Pawns.Num(); Index++)
+	{
+		// Clamp so pawns skipped for a long time don't overflow, a long catch up fully resets the tilt anyway.
+		FramesSinceUpdate[Index] = FMath::Min(FramesSinceUpdate[Index] + 1, 1000);
+		int32 Interval = GetUpdateInterval(Index, ViewLocations);
+		if (Interval == 0 || FramesSinceUpdate[Index] < Interval)
+			continue;
+
+		AFlybotPlayerPawn* Pawn = Pawns[Index];
+		UpdateIndices.Add(Index);
+		UpdateFrames.Add(FramesSinceUpdate[Index]);
+		UpdateTiltInputs.Add(Pawn->TiltInput);
+		Pawn->TiltInput = 0.f;
+		FramesSinceUpdate[Index] = 0;
+	}
+
+	int32 NumUpdates = UpdateIndices.Num();
+	INC_DWORD_STAT_BY(STAT_FlybotAnimatedPawns, NumUpdates);
+	INC_DWORD_STAT_BY(STAT_FlybotSkippedPawnAnimations, Pawns.Num() - NumUpdates);
+
+	// Compute hover and tilt for every updated pawn. The tilt resets by a fixed amount each frame, so
+	// pawns updated less often catch up on the frames they skipped.
+	float Time = GetWorld()->GetTimeSeconds();
+	UpdateLocations.SetNumUninitialized(NumUpdates, false);
+	for (int32 Update = 0; Update < NumUpdates; Update++)
+	{
+		int32 Index = UpdateIndices[Update];
+		UpdateLocations[Update] = ZAmplitudes[Index] ?
+			FVector(0.f, 0.f, FMath::Sin(Time * ZFrequencies[Index]) * ZAmplitudes[Index] + ZOffsets[Index]) :
+			Bodies[Index]->GetRelativeLocation();
+
+		float Roll = Rolls[Index];
+		if (UpdateTiltInputs[Update] != 0.f)
+		{
+			Roll = FMath::Clamp(Roll + UpdateTiltInputs[Update], -TiltMaxes[Index], TiltMaxes[Index]);
+		}
+
+		float Reset = TiltResetScales[Index] * UpdateFrames[Update];
+		Rolls[Index] = Roll > 0.f ? FMath::Max(Roll - Reset, 0.f) : FMath::Min(Roll + Reset, 0.f);
+	}
+
+	// Set the head rotation without updating it, so moving the body updates both in one pass. The head
+	// only changes when the roll does, and then the body changes too, so the update always happens.
+	for (int32 Update = 0; Update < NumUpdates; Update++)
+	{
+		int32 Index = UpdateIndices[Update];
+		FRotator Rotation = BaseRotations[Index];
+		Rotation.Roll = Rolls[Index];
+
+		Heads[Index]->SetRelativeRotation_Direct(FRotator(0.f, Rolls[Index], 0.f));
+		Bodies[Index]->SetRelativeLocationAndRotation(UpdateLocations[Update], Rotation);
+	}
+}
@@ -0,0 +1,115 @@
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "FlybotPawnAnimator.generated.h"
+
+/**
+ * Animates the hover and tilt of all pawns in one pass per frame instead of in each pawn's tick.
+ * Animation state is kept in one array per value, and each pawn's body and head are moved with a
+ * single transform update. Pawns we don't control are updated less often the further they are from
+ * the view, and not at all while they are off screen or past MaxDistance.
+ */
+UCLASS()
+class FLYBOT_API UFlybotPawnAnimator : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	UFlybotPawnAnimator();
+
+	/** Dedicated servers don't render, so they don't need animation. */
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+
+	/** Only animate in worlds where gameplay actually runs. */
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	/** Animate all pawns that are due for an update. */
+	virtual void Tick(float DeltaTime) override;
+
+	/** Stat used when ticking the subsystem. */
+	virtual TStatId GetStatId() const override;
+
+	/** Start animating a pawn, using the animation settings from the pawn. */
+	void RegisterPawn(class AFlybotPlayerPawn* Pawn);
+
+	/** Stop animating a pawn. */
+	void UnregisterPawn(class AFlybotPlayerPawn* Pawn);
+
+	/** Pawns closer than this to the view are animated every frame. */
+	UPROPERTY(EditAnywhere)
+	float NearDistance;
+
+	/** Pawns closer than this are animated every other frame, further ones every FarUpdateInterval frames. */
+	UPROPERTY(EditAnywhere)
+	float MidDistance;
+
+	/** Frames between updates for pawns past MidDistance. */
+	UPROPERTY(EditAnywhere, meta = (ClampMin = 1))
+	int32 FarUpdateInterval;
+
+	/** Pawns further than this are not animated at all, 0 for no limit. */
+	UPROPERTY(EditAnywhere)
+	float MaxDistance;
+
+	/** Pawns not rendered for this many seconds are considered off screen. */
+	UPROPERTY(EditAnywhere)
+	float OffScreenTime;
+
+private:
+	/** Frames between updates for a pawn, 0 to skip it this frame. */
+	int32 GetUpdateInterval(int32 Index, const TArray<FVector, TInlineAllocator<4>>& ViewLocations) const;
+
+	/** Remove the pawn at Index from all arrays, swapping the last pawn into its place. */
+	void RemovePawnAtSwap(int32 Index);
+
+	/*
+	* Pawns, stored as one array per value with the same index used across them.
+	*/
+
+	/** Pawns being animated. */
+	UPROPERTY()
+	TArray<class AFlybotPlayerPawn*> Pawns;
+
+	/** Body component of each pawn, moved for hover and tilt. */
+	TArray<class USceneComponent*> Bodies;
+
+	/** Head component of each pawn, attached to the body. */
+	TArray<class USceneComponent*> Heads;
+
+	/** Body rotation each pawn started with, tilt is added to the roll. */
+	TArray<FRotator> BaseRotations;
+
+	/** Hover settings for each pawn. */
+	TArray<float> ZAmplitudes;
+	TArray<float> ZFrequencies;
+	TArray<float> ZOffsets;
+
+	/** Tilt settings for each pawn. */
+	TArray<float> TiltMaxes;
+	TArray<float> TiltResetScales;
+
+	/** Current tilt of each pawn. */
+	TArray<float> Rolls;
+
+	/** Frames since each pawn was last animated. */
+	TArray<int32> FramesSinceUpdate;
+
+	/*
+	* Per frame scratch arrays, reused to avoid allocating every frame.
+	*/
+
+	/** Indices of the pawns animated this frame. */
+	TArray<int32> UpdateIndices;
+
+	/** Frames each updated pawn is catching up on. */
+	TArray<int32> UpdateFrames;
+
+	/** Tilt input gathered from each updated pawn. */
+	TArray<float> UpdateTiltInputs;
+
+	/** Body location computed for each updated pawn. */
+	TArray<FVector> UpdateLocations;
+};
@@ -1,9 +1,15 @@
 // Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
 
 #include "FlybotPlayerController.h"
+#include "Flybot.h"
+#include "EnhancedInputSubsystems.h"
+#include "Engine/GameInstance.h"
+#include "Engine/GameViewportClient.h"
+#include "Engine/LocalPlayer.h"
 #include "InputAction.h"
 #include "InputMappingContext.h"
 #include "InputModifiers.h"
+#include "Misc/CommandLine.h"
 
 /** Map key to action for mapping context with optional modifiers. */
 static void MapKey(UInputMappingContext* InputMappingContext, UInputAction* InputAction, FKey Key,
@@ -27,6 +33,17 @@ static void MapKey(UInputMappingContext* InputMappingContext, UInputAction* Inpu
 	}
 }
 
+AFlybotPlayerController::AFlybotPlayerController()
+{
+	BotMode = EFlybotBotMode::None;
+	BotInputInterval = 2.f;
+	BotShootChance = 0.3f;
+	BotInputTimeLeft = 0.f;
+	BotMoveInput = FVector::ZeroVector;
+	BotRotateInput = FVector::ZeroVector;
+	bBotShooting = false;
+}
+
 void AFlybotPlayerController::SetupInputComponent()
 {
 	Super::SetupInputComponent();
@@ -60,4 +77,105 @@ void AFlybotPlayerController::SetupInputComponent()
 	ShootAction = NewObject<UInputAction>(this);
 	ShootAction->ValueType = EInputActionValueType::Axis1D;
 	MapKey(PawnMappingContext, ShootAction, EKeys::LeftMouseButton);
-}
\ No newline at end of file
+}
+
+/*
+* Bots
+*/
+
+void AFlybotPlayerController::BeginPlay()
+{
+	Super::BeginPlay();
+
+	ULocalPlayer* LocalPlayer = GetLocalPlayer();
+	if (!LocalPlayer || !FParse::Param(FCommandLine::Get(), TEXT("FlybotBot")))
+		return;
+
+	FString ModeName;
+	FParse::Value(FCommandLine::Get(), TEXT("FlybotBotMode="), ModeName);
+	BotMode = ModeName == TEXT("Circle") ? EFlybotBotMode::Circle : EFlybotBotMode::Random;
+
+	// Offset the seed for each local player so bots in the same process don't move together.
+	int32 Seed = FPlatformTime::Cycles();
+	FParse::Value(FCommandLine::Get(), TEXT("FlybotBotSeed="), Seed);
+	BotRandom.Initialize(Seed + LocalPlayer->GetControllerId());
+
+	UE_LOG(LogFlybot, Log, TEXT("Bot %s started in %s mode"), *GetName(), *UEnum::GetValueAsString(BotMode));
+
+	if (LocalPlayer == GetGameInstance()->GetFirstGamePlayer())
+	{
+		AddBotPlayers();
+	}
+}
+
+void AFlybotPlayerController::AddBotPlayers()
+{
+	int32 NumBots = 1;
+	if (!FParse::Value(FCommandLine::Get(), TEXT("FlybotBots="), NumBots) || NumBots <= 1)
+		return;
+
+	// Extra players join through the same connection as split screen players, so they don't need
+	// a viewport of their own.
+	UGameInstance* GameInstance = GetGameInstance();
+	if (UGameViewportClient* ViewportClient = GameInstance->GetGameViewportClient())
+	{
+		ViewportClient->MaxSplitscreenPlayers = FMath::Max(ViewportClient->MaxSplitscreenPlayers, NumBots);
+		ViewportClient->SetForceDisableSplitscreen(true);
+	}
+
+	for (int32 ControllerId = GameInstance->GetNumLocalPlayers(); ControllerId < NumBots; ControllerId++)
+	{
+		FString Error;
+		if (!GameInstance->CreateLocalPlayer(ControllerId, Error, true))
+		{
+			UE_LOG(LogFlybot, Warning, TEXT("Could not add bot %d: %s"), ControllerId, *Error);
+			break;
+		}
+	}
+}
+
+void AFlybotPlayerController::PlayerTick(float DeltaTime)
+{
+	if (BotMode != EFlybotBotMode::None && GetPawn())
+	{
+		UpdateBotInput(DeltaTime);
+	}
+
+	Super::PlayerTick(DeltaTime);
+}
+
+void AFlybotPlayerController::UpdateBotInput(float DeltaTime)
+{
+	BotInputTimeLeft -= DeltaTime;
+	if (BotInputTimeLeft <= 0.f)
+	{
+		BotInputTimeLeft += BotInputInterval;
+
+		if (BotMode == EFlybotBotMode::Circle)
+		{
+			BotMoveInput = FVector(1.f, 0.f, 0.f);
+			BotRotateInput = FVector(0.f, 0.25f, 0.f);
+			bBotShooting = !bBotShooting;
+		}
+		else
+		{
+			BotMoveInput = BotRandom.GetUnitVector();
+			BotRotateInput = FVector(BotRandom.FRandRange(-1.f, 1.f), BotRandom.FRandRange(-1.f, 1.f), 0.f);
+			bBotShooting = BotRandom.FRand() < BotShootChance;
+		}
+	}
+
+	// Injected input goes through the same triggers and bindings as device input, so the pawn's Move,
+	// Rotate and Shoot run exactly as they would for a player. Not injecting shoot input releases it.
+	UEnhancedInputLocalPlayerSubsystem* Subsystem =
+		ULocalPlayer::GetSubsystem<UEnhancedInputLocalPlayerSubsystem>(GetLocalPlayer());
+	if (!Subsystem || !MoveAction)
+		return;
+
+	Subsystem->InjectInputForAction(MoveAction, FInputActionValue(BotMoveInput));
+	Subsystem->InjectInputForAction(RotateAction, FInputActionValue(BotRotateInput));
+	if (bBotShooting)
+	{
+		Subsystem->InjectInputForAction(ShootAction, FInputActionValue(1.f));
+	}
+}
@@ -6,15 +6,37 @@
 #include "GameFramework/PlayerController.h"
 #include "FlybotPlayerController.generated.h"
 
+/** How a bot controller generates input, set with -FlybotBotMode=. */
+UENUM()
+enum class EFlybotBotMode : uint8
+{
+	/** Controlled by a player. */
+	None,
+
+	/** Pick new random movement, rotation and shooting every BotInputInterval. */
+	Random,
+
+	/** Fly forward while turning and shoot every other BotInputInterval, the same every run. */
+	Circle
+};
+
 UCLASS()
 class FLYBOT_API AFlybotPlayerController : public APlayerController
 {
 	GENERATED_BODY()
 
 public:
+	AFlybotPlayerController();
+
 	/** Setup input actions and context mappings for player. */
 	virtual void SetupInputComponent() override;
 
+	/** Start bot mode and add extra bot players when running with -FlybotBot. */
+	virtual void BeginPlay() override;
+
+	/** Inject bot input before the player input is processed. */
+	virtual void PlayerTick(float DeltaTime) override;
+
 	/** Mapping context used for pawn control. */
 	UPROPERTY()
 	class UInputMappingContext* PawnMappingContext;
@@ -38,4 +60,38 @@ public:
 	/** Action to start and stop shooting. */
 	UPROPERTY()
 	class UInputAction* ShootAction;
+
+	/** How bot input is generated, None for players. */
+	UPROPERTY(EditAnywhere, Category = "Bot")
+	EFlybotBotMode BotMode;
+
+	/** Seconds between bot input changes. */
+	UPROPERTY(EditAnywhere, Category = "Bot")
+	float BotInputInterval;
+
+	/** Chance of a random bot shooting after each input change. */
+	UPROPERTY(EditAnywhere, Category = "Bot")
+	float BotShootChance;
+
+private:
+	/** Add local players until there are -FlybotBots= of them, each with their own bot controller. */
+	void AddBotPlayers();
+
+	/** Pick new bot input when the interval is up and inject it as if it came from the input devices. */
+	void UpdateBotInput(float DeltaTime);
+
+	/** Random stream for bot input, seeded differently for each bot. */
+	FRandomStream BotRandom;
+
+	/** Seconds until the bot input changes. */
+	float BotInputTimeLeft;
+
+	/** Current bot move input, in the same axes as MoveAction. */
+	FVector BotMoveInput;
+
+	/** Current bot rotate input, in the same axes as RotateAction. */
+	FVector BotRotateInput;
+
+	/** Whether the bot is currently shooting. */
+	bool bBotShooting;
 };
\ No newline at end of file
@@ -3,18 +3,48 @@
 #include "FlybotPlayerHUD.h"
 #include "Components/ProgressBar.h"
 
-void UFlybotPlayerHUD::SetHealth(float CurrentHealth, float MaxHealth)
+void UFlybotPlayerHUD::SetViewModel(UFlybotHUDViewModel* InViewModel)
 {
-	if (HealthBar)
+	if (ViewModel)
 	{
-		HealthBar->SetPercent(CurrentHealth / MaxHealth);
+		ViewModel->OnStatChanged.Remove(StatChangedHandle);
 	}
+
+	ViewModel = InViewModel;
+	if (!ViewModel)
+		return;
+
+	StatChangedHandle = ViewModel->OnStatChanged.AddUObject(this, &UFlybotPlayerHUD::OnStatChanged);
+	for (uint8 Stat = 0; Stat < uint8(EFlybotHUDStat::Num); Stat++)
+	{
+		OnStatChanged(EFlybotHUDStat(Stat), ViewModel->GetStatFraction(EFlybotHUDStat(Stat)));
+	}
+}
+
+void UFlybotPlayerHUD::NativeDestruct()
+{
+	SetViewModel(nullptr);
+	Super::NativeDestruct();
 }
 
-void UFlybotPlayerHUD::SetPower(float CurrentPower, float MaxPower)
+void UFlybotPlayerHUD::OnStatChanged(EFlybotHUDStat Stat, float Fraction)
 {
-	if (PowerBar)
+	// Setting the percent only invalidates the bar's paint, the rest of the HUD stays cached.
+	if (UProgressBar* Bar = GetStatBar(Stat))
 	{
-		PowerBar->SetPercent(CurrentPower / MaxPower);
+		Bar->SetPercent(Fraction);
 	}
-}
\ No newline at end of file
+}
+
+UProgressBar* UFlybotPlayerHUD::GetStatBar(EFlybotHUDStat Stat) const
+{
+	switch (Stat)
+	{
+	case EFlybotHUDStat::Health:
+		return HealthBar;
+	case EFlybotHUDStat::Power:
+		return PowerBar;
+	default:
+		return nullptr;
+	}
+}
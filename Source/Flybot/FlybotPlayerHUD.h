@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "Blueprint/UserWidget.h"
+#include "FlybotHUDViewModel.h"
 #include "FlybotPlayerHUD.generated.h"
 
 UCLASS(Abstract)
@@ -12,11 +13,11 @@ class FLYBOT_API UFlybotPlayerHUD : public UUserWidget
 	GENERATED_BODY()
 
 public:
-	/** Update HUD with current health. */
-	void SetHealth(float CurrentHealth, float MaxHealth);
+	/** Show the stats from a view model, updating only when it reports a change. */
+	void SetViewModel(class UFlybotHUDViewModel* InViewModel);
 
-	/** Update HUD with current power. */
-	void SetPower(float CurrentPower, float MaxPower);
+	/** Stop listening to the view model. */
+	virtual void NativeDestruct() override;
 
 	/** Widget to use to display current health. */
 	UPROPERTY(EditAnywhere, meta = (BindWidget))
@@ -25,4 +26,17 @@ public:
 	/** Widget to use to display current power. */
 	UPROPERTY(EditAnywhere, meta = (BindWidget))
 	class UProgressBar* PowerBar;
-};
\ No newline at end of file
+
+private:
+	/** Update the widget for a stat that changed. */
+	void OnStatChanged(EFlybotHUDStat Stat, float Fraction);
+
+	/** Progress bar that displays a stat. */
+	class UProgressBar* GetStatBar(EFlybotHUDStat Stat) const;
+
+	/** View model the HUD is showing. */
+	UPROPERTY()
+	class UFlybotHUDViewModel* ViewModel;
+
+	FDelegateHandle StatChangedHandle;
+};
@@ -2,20 +2,51 @@
 
 #include "FlybotPlayerPawn.h"
 #include "Flybot.h"
+#include "FlybotAttributeComponent.h"
 #include "FlybotPlayerController.h"
+#include "FlybotHUDViewModel.h"
+#include "FlybotMapGeometry.h"
+#include "FlybotMoveValidator.h"
+#include "FlybotPawnAnimator.h"
 #include "FlybotPlayerHUD.h"
+#include "FlybotProjectileManager.h"
+#include "FlybotServerStats.h"
 #include "FlybotShot.h"
+#include "FlybotShotPool.h"
+#include "FlybotSpringArmComponent.h"
 #include "Blueprint/UserWidget.h"
 #include "Camera/CameraComponent.h"
 #include "Components/StaticMeshComponent.h"
+#include "DrawDebugHelpers.h"
+#include "Engine/NetDriver.h"
 #include "EnhancedInputComponent.h"
 #include "EnhancedInputSubsystems.h"
 #include "GameFramework/FloatingPawnMovement.h"
 #include "GameFramework/SpringArmComponent.h"
+#include "Net/Core/PushModel/PushModel.h"
 #include "Net/UnrealNetwork.h"
 
+static TAutoConsoleVariable<bool> CVarFlybotPawnInterpolation(
+	TEXT("Flybot.PawnInterpolation"),
+	true,
+	TEXT("Interpolate simulated pawns from a buffer of replicated transforms instead of snapping to each one."));
+
+static TAutoConsoleVariable<bool> CVarFlybotPawnInterpolationDebug(
+	TEXT("Flybot.PawnInterpolationDebug"),
+	false,
+	TEXT("Draw the interpolation buffer of simulated pawns, with its depth in milliseconds."));
+
+DECLARE_CYCLE_STAT(TEXT("Pawn Tick"), STAT_FlybotPawnTick, STATGROUP_Flybot);
+DECLARE_CYCLE_STAT(TEXT("Pawn Update Server Transform"), STAT_FlybotPawnUpdateServerTransform, STATGROUP_Flybot);
+DECLARE_CYCLE_STAT(TEXT("Pawn Try Shooting"), STAT_FlybotPawnTryShooting, STATGROUP_Flybot);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Push Model Comparisons Skipped"), STAT_FlybotPushModelComparisonsSkipped, STATGROUP_Flybot);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Moves Processed"), STAT_FlybotMovesProcessed, STATGROUP_Flybot);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Corrections Sent"), STAT_FlybotCorrectionsSent, STATGROUP_Flybot);
+
 AFlybotPlayerPawn::AFlybotPlayerPawn()
 {
+	DirtyReplicatedProperties = 0;
+
 	Collision = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("Collision"));
 	SetRootComponent(Collision);
 	Collision->SetVisibleFlag(false);
@@ -27,7 +58,7 @@ AFlybotPlayerPawn::AFlybotPlayerPawn()
 	Head->SetupAttachment(Body);
 
 	// Springarm and Camera
-	SpringArm = CreateDefaultSubobject<USpringArmComponent>(TEXT("SpringArm"));
+	SpringArm = CreateDefaultSubobject<UFlybotSpringArmComponent>(TEXT("SpringArm"));
 	SpringArm->SetupAttachment(Collision);
 	SpringArm->SetRelativeLocation(FVector(120.f, 0.f, 50.f));
 	SpringArm->SetRelativeRotation(FRotator(-15.f, 0.f, 0.f));
@@ -52,14 +83,27 @@ AFlybotPlayerPawn::AFlybotPlayerPawn()
 	MoveScale = 1.f;
 	RotateScale = 50.f;
 	bFreeFly = false;
+	SavedMoveInterval = 1.f / 60.f;
+	MoveSendRate = 30.f;
+	MaxMovesPerPacket = 8;
+	MoveSendLastTime = 0.f;
+	MoveSequence = 0;
+	AckedMoveSequence = 0;
 	SpeedCheckInterval = 0.5f;
-	SpeedCheckTranslationSum = FVector::ZeroVector;
-	SpeedCheckTranslationCount = 0;
+	SpeedCheckTimeTolerance = 0.1f;
 	SpeedCheckLastTranslation = FVector::ZeroVector;
 	SpeedCheckLastTime = 0.f;
-	MaxMovesWithHits = 30;
+	SpeedCheckLastServerTime = 0.f;
+	bSendCorrection = false;
+	CorrectionSequence = 0;
+	CorrectionSpeed = 0.f;
+	MaxMovesWithHits = 4;
 	MovesWithHits = 0;
 
+	// Interpolation
+	InterpolationDelay = 0.15f;
+	MaxExtrapolationTime = 0.25f;
+
 	// Pawn Animation
 	ZMovementFrequency = 2.f;
 	ZMovementAmplitude = 5.f;
@@ -77,19 +121,20 @@ AFlybotPlayerPawn::AFlybotPlayerPawn()
 	ShootingOffset = FVector(300.f, 0.f, 0.f);
 	ShotClass = AFlybotShot::StaticClass();
 	ShootingLastTime = 0.f;
+	ShotPoolPrewarmSize = 11;
 
 	// HUD
 	PlayerHUDClass = nullptr;
 	PlayerHUD = nullptr;
+	HUDViewModel = nullptr;
 
-	// Health
-	MaxHealth = 25.f;
-	Health = MaxHealth;
+	// Health and Power
+	Attributes = CreateDefaultSubobject<UFlybotAttributeComponent>(TEXT("Attributes"));
 
-	// Power
-	MaxPower = 25.f;
-	Power = MaxPower;
-	PowerRegenerateRate = 1.f;
+	// Lag Compensation
+	CollisionHistorySize = 32;
+	CollisionHistoryHead = 0;
+	CollisionHistoryCount = 0;
 
 	// Allow ticking for the pawn.
 	PrimaryActorTick.bCanEverTick = true;
@@ -97,6 +142,10 @@ AFlybotPlayerPawn::AFlybotPlayerPawn()
 	// We should match this to FlybotShot (life span * speed) so they are destroyed at the same distance.
 	NetCullDistanceSquared = 1600000000.f;
 
+	// Simulated proxies interpolate between updates, so they stay smooth at a lower rate. This is every
+	// other frame at the server tick rate, so InterpolationDelay needs to cover at least two updates.
+	NetUpdateFrequency = 15.f;
+
 	// Force pawn to always spawn, even if it is colliding with another object.
 	SpawnCollisionHandlingMethod = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
 }
@@ -104,8 +153,44 @@ AFlybotPlayerPawn::AFlybotPlayerPawn()
 void AFlybotPlayerPawn::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
 {
 	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
-	DOREPLIFETIME_CONDITION(AFlybotPlayerPawn, bShooting, COND_SimulatedOnly);
-	DOREPLIFETIME_CONDITION(AFlybotPlayerPawn, Health, COND_OwnerOnly);
+
+	FDoRepLifetimeParams SimulatedOnlyParams;
+	SimulatedOnlyParams.bIsPushBased = true;
+	SimulatedOnlyParams.Condition = COND_SimulatedOnly;
+	DOREPLIFETIME_WITH_PARAMS_FAST(AFlybotPlayerPawn, bShooting, SimulatedOnlyParams);
+
+	FDoRepLifetimeParams OwnerOnlyParams;
+	OwnerOnlyParams.bIsPushBased = true;
+	OwnerOnlyParams.Condition = COND_OwnerOnly;
+	DOREPLIFETIME_WITH_PARAMS_FAST(AFlybotPlayerPawn, AckedMoveSequence, OwnerOnlyParams);
+	DOREPLIFETIME_WITH_PARAMS_FAST(AFlybotPlayerPawn, MoveCorrection, OwnerOnlyParams);
+}
+
+void AFlybotPlayerPawn::PreReplication(IRepChangedPropertyTracker& ChangedPropertyTracker)
+{
+	Super::PreReplication(ChangedPropertyTracker);
+
+	INC_DWORD_STAT_BY(STAT_FlybotPushModelComparisonsSkipped,
+		NumReplicatedProperties - FMath::CountBits(DirtyReplicatedProperties));
+	DirtyReplicatedProperties = 0;
+}
+
+void AFlybotPlayerPawn::MarkReplicatedPropertyDirty(EReplicatedProperty Property)
+{
+	DirtyReplicatedProperties |= uint8(Property);
+
+	switch (Property)
+	{
+	case EReplicatedProperty::bShooting:
+		MARK_PROPERTY_DIRTY_FROM_NAME(AFlybotPlayerPawn, bShooting, this);
+		break;
+	case EReplicatedProperty::AckedMoveSequence:
+		MARK_PROPERTY_DIRTY_FROM_NAME(AFlybotPlayerPawn, AckedMoveSequence, this);
+		break;
+	case EReplicatedProperty::MoveCorrection:
+		MARK_PROPERTY_DIRTY_FROM_NAME(AFlybotPlayerPawn, MoveCorrection, this);
+		break;
+	}
 }
 
 void AFlybotPlayerPawn::SetupPlayerInputComponent(UInputComponent* PlayerInputComponent)
@@ -136,25 +221,63 @@ void AFlybotPlayerPawn::BeginPlay()
 {
 	Super::BeginPlay();
 
+	Attributes->SetShotClass(ShotClass);
+
+	UFlybotShotPool* ShotPool = GetWorld()->GetSubsystem<UFlybotShotPool>();
+	if (ShotPool)
+	{
+		ShotPool->Prewarm(ShotClass, ShotPoolPrewarmSize);
+	}
+
+	UFlybotProjectileManager* ProjectileManager = GetWorld()->GetSubsystem<UFlybotProjectileManager>();
+	if (ProjectileManager)
+	{
+		ProjectileManager->RegisterPawn(this);
+		CollisionHistory.SetNum(CollisionHistorySize);
+	}
+
+	// Dedicated servers don't have an animator, since they don't need animation.
+	UFlybotPawnAnimator* PawnAnimator = GetWorld()->GetSubsystem<UFlybotPawnAnimator>();
+	if (PawnAnimator)
+	{
+		PawnAnimator->RegisterPawn(this);
+	}
+
 	if (IsLocallyControlled() && PlayerHUDClass)
 	{
+		HUDViewModel = NewObject<UFlybotHUDViewModel>(this);
+		UpdateHUDStats();
+
 		AFlybotPlayerController* FPC = GetController<AFlybotPlayerController>();
 		check(FPC);
 		PlayerHUD = CreateWidget<UFlybotPlayerHUD>(FPC, PlayerHUDClass);
 		check(PlayerHUD);
+		PlayerHUD->SetViewModel(HUDViewModel);
 		PlayerHUD->AddToPlayerScreen();
-		PlayerHUD->SetHealth(Health, MaxHealth);
-		PlayerHUD->SetPower(Power, MaxPower);
 	}
 }
 
 void AFlybotPlayerPawn::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
+	UFlybotProjectileManager* ProjectileManager = GetWorld()->GetSubsystem<UFlybotProjectileManager>();
+	if (ProjectileManager)
+	{
+		ProjectileManager->UnregisterPawn(this);
+	}
+
+	UFlybotPawnAnimator* PawnAnimator = GetWorld()->GetSubsystem<UFlybotPawnAnimator>();
+	if (PawnAnimator)
+	{
+		PawnAnimator->UnregisterPawn(this);
+	}
+
 	if (PlayerHUD)
 	{
+		PlayerHUD->SetViewModel(nullptr);
 		PlayerHUD->RemoveFromParent();
 		// We can't destroy the widget directly, let the GC take care of it.
 		PlayerHUD = nullptr;
+		HUDViewModel = nullptr;
 	}
 
 	Super::EndPlay(EndPlayReason);
@@ -162,22 +285,53 @@ void AFlybotPlayerPawn::EndPlay(const EEndPlayReason::Type EndPlayReason)
 
 void AFlybotPlayerPawn::Tick(float DeltaSeconds)
 {
+	FLYBOT_SCOPE_CYCLE_COUNTER(STAT_FlybotPawnTick);
+
 	Super::Tick(DeltaSeconds);
 
-	RegeneratePower();
 	TryShooting();
 
-	// Don't animate if we're the server.
-	if (GetNetMode() != NM_DedicatedServer)
+	if (HUDViewModel)
+	{
+		UpdateHUDStats();
+	}
+
+	if (CollisionHistory.Num() > 0)
 	{
-		UpdatePawnAnimation();
+		RecordCollisionHistory();
 	}
 
 	// Replicate movement to server if we're the client controlling the pawn.
 	if (GetLocalRole() == ROLE_AutonomousProxy)
 	{
-		UpdateServerTransform(Collision->GetRelativeTransform());
+		SaveMove();
+		SendServerTransform();
+	}
+	else if (GetLocalRole() == ROLE_SimulatedProxy && InterpolationBuffer.Num() > 0)
+	{
+		UpdateInterpolation();
+	}
+}
+
+void AFlybotPlayerPawn::PostNetReceiveLocationAndRotation()
+{
+	if (GetLocalRole() != ROLE_SimulatedProxy || !CVarFlybotPawnInterpolation.GetValueOnGameThread())
+	{
+		InterpolationBuffer.Reset();
+		Super::PostNetReceiveLocationAndRotation();
+		return;
+	}
+
+	// Start from where the pawn is shown, so moving again after the buffer expired doesn't snap.
+	float Now = GetWorld()->GetTimeSeconds();
+	if (InterpolationBuffer.Num() == 0)
+	{
+		InterpolationBuffer.Add(Now - InterpolationDelay, GetActorLocation(), GetActorQuat());
 	}
+
+	const FRepMovement& RepMovement = GetReplicatedMovement();
+	InterpolationBuffer.Add(Now,
+		FRepMovement::RebaseOntoLocalOrigin(RepMovement.Location, this), RepMovement.Rotation.Quaternion());
 }
 
 /*
@@ -225,117 +379,393 @@ void AFlybotPlayerPawn::ToggleFreeFly()
 	bFreeFly = !bFreeFly;
 }
 
-void AFlybotPlayerPawn::UpdateServerTransform_Implementation(FTransform Transform)
+void AFlybotPlayerPawn::SaveMove()
 {
-	// Make sure the client does not try to move faster than the game allows. We can't check
-	// on each update using the server delta time since the server may tick at different rates
-	// than the client, and the server might process multiple updates in one tick. Instead, we
-	// calculate an average position every SpeedCheckInterval and check the speed using that.
 	float Now = GetWorld()->GetRealTimeSeconds();
-	if (SpeedCheckLastTime == 0)
+	FTransform Transform = Collision->GetRelativeTransform();
+	FVector Position = FFlybotMovePacket::QuantizePosition(Transform.GetTranslation());
+	FRotator Rotation = Transform.Rotator();
+
+	// Skip saving a move if we haven't moved, or if the last move was too recent. The next saved
+	// move will include where we end up.
+	if (LastSavedMove.Sequence == MoveSequence && MoveSequence != 0 &&
+		(Now - LastSavedMove.Timestamp < SavedMoveInterval ||
+		(LastSavedMove.Position == Position && LastSavedMove.Rotation.Equals(Rotation))))
+	{
+		return;
+	}
+
+	LastSavedMove.Sequence = ++MoveSequence;
+	LastSavedMove.Timestamp = Now;
+	LastSavedMove.Position = Position;
+	LastSavedMove.Rotation = Rotation;
+	SavedMoves.Add(LastSavedMove);
+	MoveHistory.Add(LastSavedMove.Sequence, Position);
+
+	// Never keep more moves than the history can find a base for.
+	if (SavedMoves.Num() > FFlybotMoveHistory::Size / 2)
 	{
-		SpeedCheckLastTranslation = Transform.GetTranslation();
-		SpeedCheckLastTime = Now;
-		SpeedCheckTranslationSum = FVector::ZeroVector;
-		SpeedCheckTranslationCount = 0;
+		SavedMoves.RemoveAt(0, 1, false);
+	}
+}
+
+void AFlybotPlayerPawn::SendServerTransform()
+{
+	// Forget moves the server has already processed.
+	int32 NumAcked = 0;
+	while (NumAcked < SavedMoves.Num() && !IsNewerMoveSequence(SavedMoves[NumAcked].Sequence, AckedMoveSequence))
+	{
+		NumAcked++;
+	}
+
+	SavedMoves.RemoveAt(0, NumAcked, false);
+	if (SavedMoves.Num() == 0)
+	{
+		return;
+	}
+
+	// There's no point sending moves faster than the server will process them.
+	float SendRate = MoveSendRate;
+	UNetDriver* NetDriver = GetNetDriver();
+	if (NetDriver && NetDriver->NetServerMaxTickRate > 0)
+	{
+		SendRate = FMath::Min(SendRate, float(NetDriver->NetServerMaxTickRate));
+	}
+
+	float Now = GetWorld()->GetRealTimeSeconds();
+	if (Now - MoveSendLastTime < 1.f / SendRate)
+	{
+		return;
+	}
+
+	// Send every unacknowledged move so a lost packet doesn't lose any moves. Positions are relative
+	// to the last move the server told us it processed, or absolute if that is too old for the history.
+	FFlybotMovePacket Packet;
+	const FVector* BasePosition = MoveHistory.Find(AckedMoveSequence);
+	Packet.bAbsolute = BasePosition == nullptr;
+	Packet.BaseSequence = AckedMoveSequence;
+	Packet.CorrectionId = MoveCorrection.Id;
+
+	FVector PreviousPosition = BasePosition ? *BasePosition : FVector::ZeroVector;
+	int32 NumMoves = FMath::Min3(SavedMoves.Num(), MaxMovesPerPacket, FFlybotMovePacket::MaxMoves);
+	for (int32 a = SavedMoves.Num() - NumMoves; a < SavedMoves.Num(); a++)
+	{
+		Packet.AddMove(SavedMoves[a], PreviousPosition);
+		PreviousPosition = SavedMoves[a].Position;
+	}
+
+	MoveSendLastTime = Now;
+	UpdateServerTransform(Packet);
+}
+
+void AFlybotPlayerPawn::UpdateServerTransform_Implementation(const FFlybotMovePacket& Packet)
+{
+	FLYBOT_SCOPE_CYCLE_COUNTER(STAT_FlybotPawnUpdateServerTransform);
+
+	// Moves sent before the client applied our last correction were predicted from the wrong place.
+	// The client sends them again after replaying them, so drop them without any validation work.
+	if (Packet.CorrectionId != MoveCorrection.Id)
+	{
+		return;
+	}
+
+	// Rebuild absolute positions the same way the client quantized them.
+	FFlybotMovePacket ResolvedPacket = Packet;
+	if (Packet.bAbsolute)
+	{
+		ResolvedPacket.ResolvePositions(FVector::ZeroVector);
 	}
 	else
 	{
-		SpeedCheckTranslationSum += Transform.GetTranslation();
-		SpeedCheckTranslationCount++;
+		const FVector* BasePosition = MoveHistory.Find(Packet.BaseSequence);
+		if (!BasePosition)
+		{
+			return;
+		}
+
+		ResolvedPacket.ResolvePositions(*BasePosition);
+	}
+
+	// Queue moves in order, skipping any we already queued from earlier packets. They are validated
+	// for all pawns at once by UFlybotMoveValidator.
+	int32 NumPendingMoves = PendingServerMoves.Num();
+	for (const FFlybotSavedMove& Move : ResolvedPacket.Moves)
+	{
+		if (MoveHistory.Find(MoveSequence) && !IsNewerMoveSequence(Move.Sequence, MoveSequence))
+		{
+			continue;
+		}
+
+		MoveSequence = Move.Sequence;
+		AckedMoveSequence = Move.Sequence;
+		MoveHistory.Add(Move.Sequence, Move.Position);
+		PendingServerMoves.Add(Move);
+		MarkReplicatedPropertyDirty(EReplicatedProperty::AckedMoveSequence);
+		INC_DWORD_STAT(STAT_FlybotMovesProcessed);
+	}
+
+	if (UFlybotServerStats* ServerStats = GetWorld()->GetSubsystem<UFlybotServerStats>())
+	{
+		ServerStats->AddServerTransformUpdate(NetStats, PendingServerMoves.Num() - NumPendingMoves);
+	}
 
-		if (Now - SpeedCheckLastTime > SpeedCheckInterval)
+	UFlybotMoveValidator* MoveValidator = GetWorld()->GetSubsystem<UFlybotMoveValidator>();
+	if (MoveValidator && PendingServerMoves.Num() > 0)
+	{
+		MoveValidator->QueuePawn(this);
+	}
+}
+
+void AFlybotPlayerPawn::ValidateServerMoves()
+{
+	FTransform Current = Collision->GetRelativeTransform();
+	float ServerNow = GetWorld()->GetRealTimeSeconds();
+	TArray<FHitResult> HitResults;
+	FComponentQueryParams QueryParams(SCENE_QUERY_STAT(FlybotServerMoveSweep), this);
+	const UFlybotMapGeometry* MapGeometry = GetWorld()->GetSubsystem<UFlybotMapGeometry>();
+	bool bAnalyticSweep = MapGeometry && MapGeometry->IsEnabled();
+	float CollisionRadius = Collision->Bounds.SphereRadius;
+	bSendCorrection = false;
+	CorrectionSpeed = 0.f;
+
+	for (const FFlybotSavedMove& Move : PendingServerMoves)
+	{
+		// Make sure the client does not try to move faster than the game allows. Each move carries the
+		// client time it was recorded at, so we can check the speed over SpeedCheckInterval using exact
+		// timings instead of when the moves happen to arrive. We still limit the elapsed time by our own
+		// clock so a client can't gain speed by running its clock fast, and check on our own clock too so
+		// a client can't skip the check by holding its clock back.
+		if (SpeedCheckLastTime == 0)
+		{
+			SpeedCheckLastTranslation = Move.Position;
+			SpeedCheckLastTime = Move.Timestamp;
+			SpeedCheckLastServerTime = ServerNow;
+		}
+		else if (Move.Timestamp - SpeedCheckLastTime > SpeedCheckInterval ||
+			ServerNow - SpeedCheckLastServerTime > SpeedCheckInterval)
 		{
-			FVector SpeedCheckTranslation = SpeedCheckTranslationSum / SpeedCheckTranslationCount;
-			float Distance = FVector::Distance(SpeedCheckLastTranslation, SpeedCheckTranslation);
-			float Speed = Distance / (Now - SpeedCheckLastTime);
-			//UE_LOG(LogFlybot, Log, TEXT("Client speed update: %s %.3f %d"), *Controller->GetName(), Speed, SpeedCheckCount);
+			float Elapsed = FMath::Min(Move.Timestamp - SpeedCheckLastTime,
+				ServerNow - SpeedCheckLastServerTime + SpeedCheckTimeTolerance);
+			float Distance = FVector::Distance(SpeedCheckLastTranslation, Move.Position);
+			float Speed = Distance / FMath::Max(Elapsed, UE_KINDA_SMALL_NUMBER);
 
-			SpeedCheckLastTime = Now;
-			SpeedCheckTranslationSum = FVector::ZeroVector;
-			SpeedCheckTranslationCount = 0;
+			SpeedCheckLastTime = Move.Timestamp;
+			SpeedCheckLastServerTime = ServerNow;
 
-			// Allow 10% more than MaxSpeed to account for time and translation variation.
+			// Allow 10% more than MaxSpeed to account for quantization and clock variation.
 			if (Speed > Movement->MaxSpeed * 1.1f)
 			{
-				// Moving too fast, ignore update and move client back to last translation.
-				UE_LOG(LogFlybot, Log, TEXT("Player moving too fast: %s %.3f"), *Controller->GetName(), Speed);
-				UpdateClientTransform(FTransform(Collision->GetRelativeRotation(), SpeedCheckLastTranslation));
-				return;
+				// Moving too fast, ignore the rest of the moves and move client back to last translation.
+				bSendCorrection = true;
+				CorrectionSequence = Move.Sequence;
+				CorrectionSpeed = Speed;
+				Current = FTransform(Current.GetRotation(), SpeedCheckLastTranslation);
+				CorrectionTransform = Current;
+				break;
 			}
 
-			SpeedCheckLastTranslation = SpeedCheckTranslation;
+			SpeedCheckLastTranslation = Move.Position;
 		}
-	}
 
-	// Move client with a sweep to see if we hit anything. We seem to get hits on the server even when
-	// the client sends valid moves, especially while sliding against objects. We'll always have a valid
-	// move on the server since the sweep will correct the server side. We expect the client to eventually
-	// send a transform that moves cleanly, but if we go too long (MaxMovesWithHits), send a correction
-	// back to the client. This will cause a stutter on the client so we want to keep it minimal.
-	FTransform OldTransform = Collision->GetRelativeTransform();
-	FHitResult HitResult;
-	Collision->SetRelativeTransform(Transform, true, &HitResult);
-	if (HitResult.bBlockingHit) {
-		//float ExpectedDistance = FVector::Distance(HitResult.TraceStart, HitResult.TraceEnd);
-		//UE_LOG(LogFlybot, Log, TEXT("Player hit object: %s %d (%.3f-%.3f=%.3f)"), *Controller->GetName(),
-		//	MovesWithHits, ExpectedDistance, HitResult.Distance, ExpectedDistance - HitResult.Distance);
-		MovesWithHits++;
-	}
-	else {
-		//UE_LOG(LogFlybot, Log, TEXT("Player move ok: %s"), *Controller->GetName());
-		MovesWithHits = 0;
+		// Move client with a sweep to see if we hit anything. We seem to get hits on the server even when
+		// the client sends valid moves, especially while sliding against objects. We'll always have a valid
+		// move on the server since the sweep will correct the server side. We expect the client to eventually
+		// send a transform that moves cleanly, but if we go too long (MaxMovesWithHits), send a correction
+		// back to the client. The client replays its newer moves from the correction, so it only sees the
+		// difference between our result and its own.
+		FQuat Rotation = Move.Rotation.Quaternion();
+		FVector Location = Move.Position;
+		bool bBlockingHit = false;
+
+		// The analytic map queries only know about rooms and tubes, so other pawns don't block.
+		if (bAnalyticSweep)
+		{
+			FFlybotMapHit MapHit;
+			if (MapGeometry->SweepSphere(Current.GetTranslation(), Move.Position, CollisionRadius, MapHit))
+			{
+				bBlockingHit = true;
+				Location = MapHit.bStartPenetrating ? Current.GetTranslation() : MapHit.Location;
+			}
+		}
+		else
+		{
+			GetWorld()->ComponentSweepMulti(HitResults, Collision, Current.GetTranslation(), Move.Position,
+				Rotation, QueryParams);
+			const FHitResult* BlockingHit = HitResults.FindByPredicate([](const FHitResult& HitResult)
+			{
+				return HitResult.bBlockingHit;
+			});
+
+			if (BlockingHit)
+			{
+				bBlockingHit = true;
+				Location = BlockingHit->bStartPenetrating ? Current.GetTranslation() : BlockingHit->Location;
+			}
+		}
+
+		if (bBlockingHit)
+		{
+			MovesWithHits++;
+		}
+		else
+		{
+			MovesWithHits = 0;
+		}
+
+		Current = FTransform(Rotation, Location);
+
+		if (MovesWithHits > MaxMovesWithHits)
+		{
+			bSendCorrection = true;
+			CorrectionSequence = Move.Sequence;
+			CorrectionTransform = Current;
+			MovesWithHits = 0;
+			break;
+		}
 	}
 
-	if (MovesWithHits > MaxMovesWithHits) {
-		UE_LOG(LogFlybot, Log, TEXT("Correcting player transform: %s"), *Controller->GetName());
-		UpdateClientTransform(Collision->GetRelativeTransform());
+	ValidatedTransform = Current;
+	PendingServerMoves.Reset();
+}
+
+void AFlybotPlayerPawn::ApplyServerMoves()
+{
+	// The sweeps were already done during validation, so teleport to the result.
+	Collision->SetRelativeTransform(ValidatedTransform);
+
+	if (bSendCorrection)
+	{
+		// Continue from the corrected move. Moves after it were acknowledged when they arrived, but
+		// were never validated, and the client will send them again from the corrected position.
+		MoveCorrection.Sequence = CorrectionSequence;
+		MoveCorrection.Id = (MoveCorrection.Id + 1) & ((1 << FFlybotMovePacket::CorrectionIdBits) - 1);
+		MoveCorrection.Position = FFlybotMovePacket::QuantizePosition(CorrectionTransform.GetTranslation());
+		MoveCorrection.Rotation = CorrectionTransform.Rotator();
+		MarkReplicatedPropertyDirty(EReplicatedProperty::MoveCorrection);
+
+		MoveSequence = CorrectionSequence;
+		AckedMoveSequence = CorrectionSequence;
+		MoveHistory.Add(CorrectionSequence, MoveCorrection.Position);
+		MarkReplicatedPropertyDirty(EReplicatedProperty::AckedMoveSequence);
+
+		if (CorrectionSpeed > 0.f)
+		{
+			UE_LOG(LogFlybot, Log, TEXT("Player moving too fast: %s %.3f"), *GetNameSafe(Controller), CorrectionSpeed);
+		}
+		else
+		{
+			UE_LOG(LogFlybot, Log, TEXT("Correcting player transform: %s"), *GetNameSafe(Controller));
+		}
+
+		INC_DWORD_STAT(STAT_FlybotCorrectionsSent);
+
+		if (UFlybotServerStats* ServerStats = GetWorld()->GetSubsystem<UFlybotServerStats>())
+		{
+			ServerStats->AddCorrection(NetStats, CorrectionSpeed > 0.f);
+		}
 	}
 }
 
-void AFlybotPlayerPawn::UpdateClientTransform_Implementation(FTransform Transform)
+void AFlybotPlayerPawn::OnRepMoveCorrection()
 {
-	Collision->SetRelativeTransform(Transform);
+	if (GetLocalRole() != ROLE_AutonomousProxy)
+	{
+		return;
+	}
+
+	FTransform Predicted = Collision->GetRelativeTransform();
+
+	// Our own position for the corrected move, before the history entry is replaced.
+	const FVector* PredictedBasePtr = MoveHistory.Find(MoveCorrection.Sequence);
+	bool bHasPredictedBase = PredictedBasePtr != nullptr;
+	FVector PredictedBase = bHasPredictedBase ? *PredictedBasePtr : FVector::ZeroVector;
+
+	// The server has processed everything up to the corrected move.
+	while (SavedMoves.Num() > 0 && !IsNewerMoveSequence(SavedMoves[0].Sequence, MoveCorrection.Sequence))
+	{
+		SavedMoves.RemoveAt(0, 1, false);
+	}
+
+	Collision->SetRelativeTransform(FTransform(MoveCorrection.Rotation, MoveCorrection.Position));
+	MoveHistory.Add(MoveCorrection.Sequence, MoveCorrection.Position);
+	LastSavedMove.Position = MoveCorrection.Position;
+
+	// Without our own position for the corrected move there is nothing to replay from, so take the
+	// server's transform as is.
+	if (!bHasPredictedBase)
+	{
+		SavedMoves.Reset();
+		return;
+	}
+
+	// Replay each unacknowledged move as the same offset from the move before it, sweeping so the
+	// replay doesn't push us into walls the server moved us next to. The replayed positions replace
+	// the saved ones, so the server receives a path that starts where it put us.
+	FVector PreviousPredicted = PredictedBase;
+	for (FFlybotSavedMove& Move : SavedMoves)
+	{
+		FVector Delta = Move.Position - PreviousPredicted;
+		PreviousPredicted = Move.Position;
+
+		Collision->SetRelativeLocationAndRotation(Collision->GetRelativeLocation() + Delta, Move.Rotation, true);
+		Move.Position = FFlybotMovePacket::QuantizePosition(Collision->GetRelativeLocation());
+		MoveHistory.Add(Move.Sequence, Move.Position);
+		LastSavedMove = Move;
+	}
+
+	// Movement since the last saved move isn't in any move yet, apply it too.
+	Collision->SetRelativeLocationAndRotation(
+		Collision->GetRelativeLocation() + Predicted.GetTranslation() - PreviousPredicted,
+		Predicted.GetRotation(), true);
+
+	// Send the replayed moves right away.
+	MoveSendLastTime = 0.f;
 }
 
 /*
-* Pawn Animation
+* Interpolation
 */
 
-void AFlybotPlayerPawn::UpdatePawnAnimation()
+void AFlybotPlayerPawn::UpdateInterpolation()
 {
-	// Add Z Movement.
-	if (ZMovementAmplitude)
+	float SampleTime = GetWorld()->GetTimeSeconds() - InterpolationDelay;
+	FVector Location;
+	FQuat Rotation;
+	if (InterpolationBuffer.Sample(SampleTime, MaxExtrapolationTime, Location, Rotation))
 	{
-		float ZMovement = FMath::Sin(GetWorld()->GetTimeSeconds() * ZMovementFrequency) * ZMovementAmplitude;
-		Body->SetRelativeLocation(FVector(0.f, 0.f, ZMovement + ZMovementOffset));
+		SetActorLocationAndRotation(Location, Rotation, false, nullptr, ETeleportType::TeleportPhysics);
 	}
 
-	// Add body and head tilting.
-	FRotator Rotation = Body->GetRelativeRotation();
-
-	if (TiltInput != 0.f)
+	if (CVarFlybotPawnInterpolationDebug.GetValueOnGameThread())
 	{
-		Rotation.Roll = FMath::Clamp(Rotation.Roll + TiltInput, -TiltMax, TiltMax);
-		TiltInput = 0.f;
+		DrawInterpolationDebug(SampleTime);
 	}
 
-	// Always try to tilt back towards the center.
-	if (Rotation.Roll > 0.f)
+	// Once the pawn has settled on the newest snapshot there is nothing left to interpolate, so stop
+	// until it moves again.
+	if (SampleTime - InterpolationBuffer.GetNewestTime() >= MaxExtrapolationTime * 2.f)
 	{
-		Rotation.Roll -= TiltResetScale;
-		if (Rotation.Roll < 0.f)
-			Rotation.Roll = 0.f;
+		InterpolationBuffer.Reset();
 	}
-	else if (Rotation.Roll < 0.f)
+}
+
+void AFlybotPlayerPawn::DrawInterpolationDebug(float SampleTime) const
+{
+#if ENABLE_DRAW_DEBUG
+	// Snapshots still ahead of the sample time are green, ones already passed are grey.
+	UWorld* World = GetWorld();
+	for (int32 Index = 0; Index < InterpolationBuffer.Num(); Index++)
 	{
-		Rotation.Roll += TiltResetScale;
-		if (Rotation.Roll > 0.f)
-			Rotation.Roll = 0.f;
+		bool bAhead = InterpolationBuffer.GetTime(Index) > SampleTime;
+		DrawDebugPoint(World, InterpolationBuffer.GetLocation(Index), 10.f, bAhead ? FColor::Green : FColor::Silver);
 	}
 
-	Body->SetRelativeRotation(Rotation);
-	Head->SetRelativeRotation(FRotator(0.f, Rotation.Roll, 0.f));
+	// Negative depth means we ran out of snapshots and are extrapolating.
+	float Depth = InterpolationBuffer.GetTime(InterpolationBuffer.Num() - 1) - SampleTime;
+	DrawDebugString(World, FVector(0.f, 0.f, 200.f),
+		FString::Printf(TEXT("%d snapshots %.0fms"), InterpolationBuffer.Num(), Depth * 1000.f),
+		const_cast<AFlybotPlayerPawn*>(this), Depth > 0.f ? FColor::Green : FColor::Red, 0.f);
+#endif
 }
 
 /*
@@ -345,41 +775,57 @@ void AFlybotPlayerPawn::UpdatePawnAnimation()
 void AFlybotPlayerPawn::Shoot(const FInputActionValue& ActionValue)
 {
 	bShooting = ActionValue[0] > 0.f;
+	MarkReplicatedPropertyDirty(EReplicatedProperty::bShooting);
 	UpdateServerShooting(bShooting);
 }
 
 void AFlybotPlayerPawn::UpdateServerShooting_Implementation(bool bNewShooting)
 {
 	bShooting = bNewShooting;
+	MarkReplicatedPropertyDirty(EReplicatedProperty::bShooting);
 }
 
 void AFlybotPlayerPawn::TryShooting()
 {
+	FLYBOT_SCOPE_CYCLE_COUNTER(STAT_FlybotPawnTryShooting);
+
 	float Now = GetWorld()->GetRealTimeSeconds();
-	float PowerDelta = Cast<AFlybotShot>(ShotClass->GetDefaultObject())->PowerDelta;
 
-	// We spawn shot actors independently on the server and all clients. This way we only need to replicate
+	// We activate shot actors independently on the server and all clients. This way we only need to replicate
 	// the shooting state changes, and not each spawned shot actor and related movement updates.
-	if (!bShooting || Now - ShootingLastTime < ShootingInterval || Power + PowerDelta <= 0)
+	if (!bShooting || Now - ShootingLastTime < ShootingInterval || !Attributes->CanShoot())
 	{
 		return;
 	}
 
 	FRotator ShotRotation = Body->GetComponentRotation();
 	FVector ShotStart = Body->GetComponentLocation() + ShotRotation.RotateVector(ShootingOffset);
-	AFlybotShot* Shot = GetWorld()->SpawnActor<AFlybotShot>(ShotClass, ShotStart, ShotRotation);
-	if (Shot)
+	// Dedicated servers don't need shot visuals, so they simulate shots without actors.
+	bool bShot = false;
+	UFlybotProjectileManager* ProjectileManager = GetWorld()->GetSubsystem<UFlybotProjectileManager>();
+	UFlybotShotPool* ShotPool = GetWorld()->GetSubsystem<UFlybotShotPool>();
+	if (ProjectileManager)
+	{
+		bShot = ProjectileManager->AddShot(ShotClass, ShotStart, ShotRotation, this);
+	}
+	else if (ShotPool)
+	{
+		bShot = ShotPool->AcquireShot(ShotClass, ShotStart, ShotRotation, this) != nullptr;
+	}
+
+	if (bShot)
 	{
 		ShootingLastTime = Now;
-		Shot->SetInstigator(this);
 
-		// Consume used power for shot and update HUD power bar.
-		Power += PowerDelta;
-		if (PlayerHUD)
+		UFlybotServerStats* ServerStats = GetWorld()->GetSubsystem<UFlybotServerStats>();
+		if (ServerStats && HasAuthority())
 		{
-			PlayerHUD->SetPower(Power, MaxPower);
+			ServerStats->AddShot();
 		}
 
+		// Consume used power for shot, the HUD picks it up on the next tick.
+		Attributes->ConsumeShotPower();
+
 		UE_LOG(LogFlybot, Log, TEXT("Shot spawned %s %s %s"), *GetName(),
 			IsNetMode(NM_Client) ? TEXT("Client") : TEXT("Server"),
 			Controller ? TEXT("Controlled") : TEXT("Simulated"));
@@ -387,20 +833,20 @@ void AFlybotPlayerPawn::TryShooting()
 }
 
 /*
-* Health
+* Health and Power
 */
 
-void AFlybotPlayerPawn::OnRepHealth()
+void AFlybotPlayerPawn::UpdateHUDStats()
 {
-	if (PlayerHUD)
-	{
-		PlayerHUD->SetHealth(Health, MaxHealth);
-	}
+	HUDViewModel->SetStat(EFlybotHUDStat::Health, Attributes->GetValue(EFlybotAttribute::Health),
+		Attributes->GetMax(EFlybotAttribute::Health));
+	HUDViewModel->SetStat(EFlybotHUDStat::Power, Attributes->GetValue(EFlybotAttribute::Power),
+		Attributes->GetMax(EFlybotAttribute::Power));
 }
 
 void AFlybotPlayerPawn::UpdateHealth(float HealthDelta)
 {
-	Health = FMath::Clamp(Health + HealthDelta, 0.f, MaxHealth);
+	float Health = Attributes->ChangeValue(EFlybotAttribute::Health, HealthDelta);
 
 	if (Health == 0.f)
 	{
@@ -408,15 +854,55 @@ void AFlybotPlayerPawn::UpdateHealth(float HealthDelta)
 	}
 }
 
+FBoxSphereBounds AFlybotPlayerPawn::GetCollisionBounds() const
+{
+	return Collision->Bounds;
+}
+
 /*
-* Power
+* Lag Compensation
 */
 
-void AFlybotPlayerPawn::RegeneratePower()
+void AFlybotPlayerPawn::RecordCollisionHistory()
 {
-	Power = FMath::Clamp(Power + (PowerRegenerateRate * GetWorld()->GetDeltaSeconds()), 0.f, MaxPower);
-	if (PlayerHUD)
+	CollisionHistoryHead = (CollisionHistoryHead + 1) % CollisionHistory.Num();
+	CollisionHistoryCount = FMath::Min(CollisionHistoryCount + 1, CollisionHistory.Num());
+
+	FCollisionHistoryEntry& Entry = CollisionHistory[CollisionHistoryHead];
+	Entry.Time = GetWorld()->GetTimeSeconds();
+	Entry.Transform = Collision->GetComponentTransform();
+}
+
+FTransform AFlybotPlayerPawn::GetRewoundCollisionTransform(float Time) const
+{
+	if (CollisionHistoryCount == 0)
 	{
-		PlayerHUD->SetPower(Power, MaxPower);
+		return Collision->GetComponentTransform();
 	}
-}
\ No newline at end of file
+
+	// Walk back from the newest entry until we find one at or before the requested time.
+	const FCollisionHistoryEntry* Newer = nullptr;
+	for (int32 a = 0; a < CollisionHistoryCount; a++)
+	{
+		int32 Index = (CollisionHistoryHead - a + CollisionHistory.Num()) % CollisionHistory.Num();
+		const FCollisionHistoryEntry& Entry = CollisionHistory[Index];
+
+		if (Entry.Time <= Time)
+		{
+			if (!Newer)
+			{
+				return Collision->GetComponentTransform();
+			}
+
+			float Alpha = (Time - Entry.Time) / FMath::Max(Newer->Time - Entry.Time, KINDA_SMALL_NUMBER);
+			FTransform Result;
+			Result.Blend(Entry.Transform, Newer->Transform, Alpha);
+			return Result;
+		}
+
+		Newer = &Entry;
+	}
+
+	// Older than anything we have, so use the oldest entry.
+	return Newer->Transform;
+}
@@ -4,6 +4,8 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Pawn.h"
+#include "FlybotMovement.h"
+#include "FlybotServerStats.h"
 #include "FlybotPlayerPawn.generated.h"
 
 UCLASS()
@@ -18,6 +20,9 @@ public:
 	/** Setup properties that should be replicated from the server to clients. */
 	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
 
+	/** Count push model properties that won't be compared this update because they aren't dirty. */
+	virtual void PreReplication(IRepChangedPropertyTracker& ChangedPropertyTracker) override;
+
 	/** Bind input actions from player controller. */
 	virtual void SetupPlayerInputComponent(class UInputComponent* PlayerInputComponent) override;
 
@@ -30,8 +35,40 @@ public:
 	/** Perform pawn updates that need to happen every frame. */
 	virtual void Tick(float DeltaSeconds) override;
 
+	/** Buffer replicated movement on simulated proxies instead of applying it straight away. */
+	virtual void PostNetReceiveLocationAndRotation() override;
+
 private:
 
+#if WITH_DEV_AUTOMATION_TESTS
+	/** Lets the performance tests call the server and shooting paths directly. */
+	friend struct FFlybotPawnTestAccess;
+#endif
+
+	/*
+	* Replication
+	*/
+
+	/**
+	 * Replicated properties use push model, so they are only compared when marked dirty. Add new
+	 * replicated properties here and mark them dirty with MarkReplicatedPropertyDirty when they change.
+	 */
+	enum class EReplicatedProperty : uint8
+	{
+		bShooting = 1 << 0,
+		AckedMoveSequence = 1 << 1,
+		MoveCorrection = 1 << 2,
+	};
+
+	/** Number of values in EReplicatedProperty. */
+	static constexpr int32 NumReplicatedProperties = 3;
+
+	/** Replicated properties marked dirty since the last net update. */
+	uint8 DirtyReplicatedProperties;
+
+	/** Mark a replicated property as changed so it gets compared and sent on the next net update. */
+	void MarkReplicatedPropertyDirty(EReplicatedProperty Property);
+
 	/** Static mesh to use for root component and collisions. */
 	UPROPERTY(EditAnywhere)
 	class UStaticMeshComponent* Collision;
@@ -100,37 +137,127 @@ private:
 	/** Handle input to toggle free flying. */
 	void ToggleFreeFly();
 
-	/** Update server with latest transform from the client. */
+	/** Update server with the latest saved moves from the client. */
 	UFUNCTION(Server, Unreliable)
-	void UpdateServerTransform(FTransform Transform);
+	void UpdateServerTransform(const FFlybotMovePacket& Packet);
+
+	/** Record the current transform as a saved move if enough time has passed. */
+	void SaveMove();
+
+	/** Send unacknowledged saved moves to the server if it's time for another packet. */
+	void SendServerTransform();
+
+	/** Minimum time between saved moves, frames in between are covered by the next move. */
+	UPROPERTY(EditAnywhere, meta = (ClampMin = 0))
+	float SavedMoveInterval;
+
+	/** How often to send moves to the server, this is also capped by the server tick rate. */
+	UPROPERTY(EditAnywhere, meta = (ClampMin = 1))
+	float MoveSendRate;
+
+	/** Most saved moves to send in one packet, older moves are dropped if we fall behind. */
+	UPROPERTY(EditAnywhere, meta = (ClampMin = 1, ClampMax = 16))
+	int32 MaxMovesPerPacket;
 
-	/** Update client transform when server needs to send a correction. */
-	UFUNCTION(Client, Unreliable)
-	void UpdateClientTransform(FTransform Transform);
+	/** Last time a move was sent to the server. */
+	float MoveSendLastTime;
 
-	/** How often to check speed with average translation for each interval. */
+	/** Moves recorded by the client that the server has not acknowledged yet, oldest first. */
+	TArray<FFlybotSavedMove> SavedMoves;
+
+	/** Last move recorded by the client, used to skip saving moves while standing still. */
+	FFlybotSavedMove LastSavedMove;
+
+	/** Sequence number of the last move saved by the client or processed by the server. */
+	uint16 MoveSequence;
+
+	/** Last move the server processed, replicated back to the client to use as a delta base. */
+	UPROPERTY(Replicated)
+	uint16 AckedMoveSequence;
+
+	/** Positions of recent moves saved by the client or processed by the server. */
+	FFlybotMoveHistory MoveHistory;
+
+	/**
+	 * Last correction the server sent. This is replicated state instead of an RPC so it can't be lost,
+	 * since the server ignores moves from the client until it applies the latest correction.
+	 */
+	UPROPERTY(ReplicatedUsing = OnRepMoveCorrection)
+	FFlybotMoveCorrection MoveCorrection;
+
+	/** Reset the client to a correction from the server and replay the moves it hasn't processed yet. */
+	UFUNCTION()
+	void OnRepMoveCorrection();
+
+	/** How often to check speed using the client timestamps of the moves. */
 	UPROPERTY(EditAnywhere)
 	float SpeedCheckInterval;
 
-	/** Current sum of translations used for average in next speed check. */
-	FVector SpeedCheckTranslationSum;
-
-	/** Current count of translations used for average in next speed check. */
-	uint32 SpeedCheckTranslationCount;
+	/** How much faster than the server clock we allow the client clock to run during a speed check. */
+	UPROPERTY(EditAnywhere)
+	float SpeedCheckTimeTolerance;
 
-	/** Last average translation used in speed check. */
+	/** Translation at the start of the current speed check. */
 	FVector SpeedCheckLastTranslation;
 
-	/** Last time speed was checked. */
+	/** Client timestamp at the start of the current speed check. */
 	float SpeedCheckLastTime;
 
-	/** Max number of consecutive moves with hits to allow from client. */
+	/** Server time at the start of the current speed check. */
+	float SpeedCheckLastServerTime;
+
+	/** Moves received from the client waiting to be validated by UFlybotMoveValidator. */
+	TArray<FFlybotSavedMove> PendingServerMoves;
+
+	/** Transform after the last validation, applied on the game thread. */
+	FTransform ValidatedTransform;
+
+	/** Correction to send after the last validation, if bSendCorrection is set. */
+	FTransform CorrectionTransform;
+
+	/** Sequence number of the move corrected by the last validation. */
+	uint16 CorrectionSequence;
+
+	/** Whether the last validation needs a correction sent to the client. */
+	bool bSendCorrection;
+
+	/** Speed the client was moving at if the last validation failed the speed check, otherwise 0. */
+	float CorrectionSpeed;
+
+	/**
+	 * Max number of consecutive moves with hits to allow from client. The client replays its moves
+	 * after a correction, so this can be low without causing visible snaps.
+	 */
 	UPROPERTY(EditAnywhere)
 	uint32 MaxMovesWithHits;
 
 	/** How many consecutive moves with hits we've seen from client. */
 	uint32 MovesWithHits;
 
+	/** Moves and corrections counted on the server for metrics. */
+	FFlybotPlayerNetStats NetStats;
+
+	/*
+	* Interpolation
+	*/
+
+	/** How far in the past simulated proxies are shown, should cover at least two net updates. */
+	UPROPERTY(EditAnywhere, meta = (ClampMin = 0))
+	float InterpolationDelay;
+
+	/** Longest time to keep moving a simulated proxy past its newest update, before settling back on it. */
+	UPROPERTY(EditAnywhere, meta = (ClampMin = 0))
+	float MaxExtrapolationTime;
+
+	/** Replicated transforms received for a simulated proxy. */
+	FFlybotInterpolationBuffer InterpolationBuffer;
+
+	/** Move a simulated proxy to its interpolated transform. */
+	void UpdateInterpolation();
+
+	/** Draw the buffered snapshots and how far ahead of the sample time they reach. */
+	void DrawInterpolationDebug(float SampleTime) const;
+
 	/*
 	* Pawn Animation
 	*/
@@ -147,7 +274,7 @@ private:
 	UPROPERTY(EditAnywhere)
 	float ZMovementOffset;
 
-	/** The current input to apply to tilt. */
+	/** Tilt input gathered since the last animation update. */
 	float TiltInput;
 
 	/** Max tilt to apply to body and head while turning. */
@@ -166,8 +293,8 @@ private:
 	UPROPERTY(EditAnywhere)
 	float TiltResetScale;
 
-	/** Perform tilting and hovering animation for pawn. */
-	void UpdatePawnAnimation();
+	/** Animates hover and tilt for all pawns together, using the settings above. */
+	friend class UFlybotPawnAnimator;
 
 	/*
 	* Shooting
@@ -189,6 +316,10 @@ private:
 	UPROPERTY(EditAnywhere)
 	TSubclassOf<class AFlybotShot> ShotClass;
 
+	/** How many free shots the pool starts with for ShotClass, enough to cover one shot life span. */
+	UPROPERTY(EditAnywhere)
+	int32 ShotPoolPrewarmSize;
+
 	/** Handle input to start and stop shooting. */
 	void Shoot(const struct FInputActionValue& ActionValue);
 
@@ -196,7 +327,7 @@ private:
 	UFUNCTION(Server, Reliable)
 	void UpdateServerShooting(bool bNewShooting);
 
-	/** Try spawning a shot actor moving in the direction of where the camera is looking. */
+	/** Try activating a shot actor moving in the direction of where the camera is looking. */
 	void TryShooting();
 
 	/** Last time we shot. */
@@ -214,44 +345,73 @@ private:
 	UPROPERTY()
 	class UFlybotPlayerHUD* PlayerHUD;
 
+	/** Stats shown on the HUD, only pushed to the widget when they visibly change. */
+	UPROPERTY()
+	class UFlybotHUDViewModel* HUDViewModel;
+
 	/*
-	* Health
+	* Health and Power
 	*/
 
-	/** Maximum amount of health to allow for player. */
+	/** Health and power, computed when read instead of regenerated every frame. */
 	UPROPERTY(EditAnywhere)
-	float MaxHealth;
+	class UFlybotAttributeComponent* Attributes;
 
-	/** Current health of player. */
-	UPROPERTY(ReplicatedUsing = OnRepHealth)
-	float Health;
-
-	/** Callback when Health is updated via replication. */
-	UFUNCTION()
-	void OnRepHealth();
+	/** Push the current health and power to the HUD, which ignores changes too small to see. */
+	void UpdateHUDStats();
 
 public:
 
 	/** Change health value for player. This should only be called on the server. */
 	void UpdateHealth(float HealthDelta);
 
+	/**
+	 * Run speed checks and collision sweeps for moves queued by UpdateServerTransform. This only
+	 * changes state owned by this pawn, so it is safe to run for several pawns in parallel.
+	 */
+	void ValidateServerMoves();
+
+	/** Move the pawn to the validated transform and send any correction, on the game thread. */
+	void ApplyServerMoves();
+
+	/** Bounds of the collision component, used for hit tests that don't go through physics. */
+	FBoxSphereBounds GetCollisionBounds() const;
+
+	/** Collision transform at a past world time, interpolated from the history recorded on the server. */
+	FTransform GetRewoundCollisionTransform(float Time) const;
+
+	/** Server stats for the player controlling this pawn. */
+	const FFlybotPlayerNetStats& GetNetStats() const { return NetStats; }
+
+	/** How far in the past simulated proxies are shown on clients. */
+	float GetInterpolationDelay() const { return InterpolationDelay; }
+
 private:
 
 	/*
-	* Power
+	* Lag Compensation
 	*/
 
-	/** Maximum amount of power to allow for player. */
-	UPROPERTY(EditAnywhere)
-	float MaxPower;
+	/** Collision transform at a point in time. */
+	struct FCollisionHistoryEntry
+	{
+		float Time;
+		FTransform Transform;
+	};
 
-	/** Current power of player. */
-	float Power;
+	/** How many collision transforms to keep for lag compensation. */
+	UPROPERTY(EditAnywhere, meta = (ClampMin = 2))
+	int32 CollisionHistorySize;
 
-	/** How much power to regenerate every second. */
-	UPROPERTY(EditAnywhere)
-	float PowerRegenerateRate;
+	/** Ring buffer of recent collision transforms, only used on dedicated servers. */
+	TArray<FCollisionHistoryEntry> CollisionHistory;
+
+	/** Index of the newest entry in CollisionHistory. */
+	int32 CollisionHistoryHead;
+
+	/** Number of valid entries in CollisionHistory. */
+	int32 CollisionHistoryCount;
 
-	/** Regenerate power during tick. */
-	void RegeneratePower();
+	/** Add the current collision transform to the history. */
+	void RecordCollisionHistory();
 };
\ No newline at end of file
@@ -0,0 +1,345 @@
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+#include "FlybotProjectileManager.h"
+#include "Flybot.h"
+#include "FlybotPlayerPawn.h"
+#include "FlybotShot.h"
+#include "Async/ParallelFor.h"
+#include "Components/SphereComponent.h"
+#include "GameFramework/PlayerState.h"
+#include "GameFramework/ProjectileMovementComponent.h"
+
+DECLARE_CYCLE_STAT(TEXT("Projectile Manager Tick"), STAT_FlybotProjectileManagerTick, STATGROUP_Flybot);
+DECLARE_CYCLE_STAT(TEXT("Lag Compensation Rewind"), STAT_FlybotLagCompensationRewind, STATGROUP_Flybot);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Simulated Shots"), STAT_FlybotSimulatedShots, STATGROUP_Flybot);
+
+/** Maximum number of grid cells to walk for a single shot before testing all pawns instead. */
+static const int32 MaxCellsPerShot = 64;
+
+UFlybotProjectileManager::UFlybotProjectileManager()
+{
+	GridCellSize = 2000.f;
+	ParallelShotThreshold = 256;
+	MaxRewindTime = 0.4f;
+	RewindStepTime = 1.f / 120.f;
+	LastTickTime = 0.f;
+}
+
+bool UFlybotProjectileManager::ShouldCreateSubsystem(UObject* Outer) const
+{
+	return IsRunningDedicatedServer() && Super::ShouldCreateSubsystem(Outer);
+}
+
+bool UFlybotProjectileManager::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UFlybotProjectileManager::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UFlybotProjectileManager, STATGROUP_Tickables);
+}
+
+void UFlybotProjectileManager::RegisterPawn(AFlybotPlayerPawn* Pawn)
+{
+	Pawns.AddUnique(Pawn);
+}
+
+void UFlybotProjectileManager::UnregisterPawn(AFlybotPlayerPawn* Pawn)
+{
+	Pawns.RemoveSwap(Pawn);
+}
+
+int32 UFlybotProjectileManager::GetShotClassIndex(TSubclassOf<AFlybotShot> ShotClass)
+{
+	int32 Index = ShotClasses.IndexOfByPredicate([&](const FShotClassInfo& Info)
+	{
+		return Info.Class == ShotClass;
+	});
+
+	if (Index == INDEX_NONE)
+	{
+		const AFlybotShot* Shot = ShotClass->GetDefaultObject<AFlybotShot>();
+		FShotClassInfo Info;
+		Info.Class = ShotClass;
+		Info.Speed = Shot->Movement->InitialSpeed;
+		Info.LifeSpan = Shot->InitialLifeSpan;
+		Info.Radius = Shot->Collision->GetScaledSphereRadius();
+		Info.HealthDelta = Shot->HealthDelta;
+		Index = ShotClasses.Add(Info);
+	}
+
+	return Index;
+}
+
+bool UFlybotProjectileManager::AddShot(TSubclassOf<AFlybotShot> ShotClass, const FVector& Location,
+	const FRotator& Rotation, AFlybotPlayerPawn* ShotInstigator)
+{
+	if (!ShotClass)
+	{
+		return false;
+	}
+
+	int32 ClassIndex = GetShotClassIndex(ShotClass);
+	const FShotClassInfo& Info = ShotClasses[ClassIndex];
+	FVector Direction = Rotation.Vector();
+
+	// Map geometry never moves, so one sweep when the shot starts tells us where it will stop.
+	// This replaces the per-frame sweeps the projectile movement component would do.
+	float MaxDistance = Info.Speed * Info.LifeSpan;
+	FHitResult HitResult;
+	FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(FlybotProjectileWorldSweep), false, ShotInstigator);
+	if (GetWorld()->SweepSingleByObjectType(HitResult, Location, Location + Direction * MaxDistance,
+		FQuat::Identity, FCollisionObjectQueryParams(ECC_WorldStatic),
+		FCollisionShape::MakeSphere(Info.Radius), QueryParams))
+	{
+		MaxDistance = HitResult.Distance;
+	}
+
+	ShotOrigins.Add(Location);
+	ShotDirections.Add(Direction);
+	ShotSpawnTimes.Add(GetWorld()->GetTimeSeconds());
+	ShotMaxDistances.Add(MaxDistance);
+	ShotClassIndices.Add(ClassIndex);
+	ShotInstigators.Add(ShotInstigator);
+	ShotRewindSteps.Add(GetRewindSteps(ShotInstigator));
+	return true;
+}
+
+void UFlybotProjectileManager::RemoveShotAtSwap(int32 Index)
+{
+	ShotOrigins.RemoveAtSwap(Index, 1, false);
+	ShotDirections.RemoveAtSwap(Index, 1, false);
+	ShotSpawnTimes.RemoveAtSwap(Index, 1, false);
+	ShotMaxDistances.RemoveAtSwap(Index, 1, false);
+	ShotClassIndices.RemoveAtSwap(Index, 1, false);
+	ShotInstigators.RemoveAtSwap(Index, 1, false);
+	ShotRewindSteps.RemoveAtSwap(Index, 1, false);
+}
+
+static FORCEINLINE FIntVector GridCell(const FVector& Location, float CellSize)
+{
+	return FIntVector(
+		FMath::FloorToInt(Location.X / CellSize),
+		FMath::FloorToInt(Location.Y / CellSize),
+		FMath::FloorToInt(Location.Z / CellSize));
+}
+
+int32 UFlybotProjectileManager::GetRewindSteps(const AFlybotPlayerPawn* ShotInstigator) const
+{
+	const APlayerState* PlayerState = ShotInstigator ? ShotInstigator->GetPlayerState() : nullptr;
+	if (!PlayerState || MaxRewindTime <= 0.f)
+	{
+		return 0;
+	}
+
+	// The shooter sees other pawns where they were about one round trip ago: the server
+	// update takes half of it to reach the client, and the shot state takes the other half to
+	// come back to us. On top of that the client shows them InterpolationDelay in the past.
+	float RewindTime = PlayerState->GetPingInMilliseconds() / 1000.f + ShotInstigator->GetInterpolationDelay();
+	RewindTime = FMath::Min(RewindTime, MaxRewindTime);
+	return FMath::RoundToInt(RewindTime / RewindStepTime);
+}
+
+void UFlybotProjectileManager::RewindPawnBounds(float Now)
+{
+	FLYBOT_SCOPE_CYCLE_COUNTER(STAT_FlybotLagCompensationRewind);
+
+	int32 MaxSteps = FMath::RoundToInt(MaxRewindTime / RewindStepTime);
+	RewindStepSlots.Init(INDEX_NONE, MaxSteps + 1);
+	RewindSlotSteps.Reset();
+
+	for (int32& Steps : ShotRewindSteps)
+	{
+		Steps = FMath::Min(Steps, MaxSteps);
+		if (RewindStepSlots[Steps] == INDEX_NONE)
+		{
+			RewindStepSlots[Steps] = RewindSlotSteps.Add(Steps);
+		}
+	}
+
+	PawnBounds.SetNumUninitialized(RewindSlotSteps.Num() * Pawns.Num(), false);
+
+	for (int32 PawnIndex = 0; PawnIndex < Pawns.Num(); PawnIndex++)
+	{
+		FBoxSphereBounds Bounds = Pawns[PawnIndex]->GetCollisionBounds();
+		FVector Location = Pawns[PawnIndex]->GetActorLocation();
+
+		for (int32 Slot = 0; Slot < RewindSlotSteps.Num(); Slot++)
+		{
+			FVector Offset = FVector::ZeroVector;
+			if (RewindSlotSteps[Slot] > 0)
+			{
+				float Time = Now - RewindSlotSteps[Slot] * RewindStepTime;
+				Offset = Pawns[PawnIndex]->GetRewoundCollisionTransform(Time).GetLocation() - Location;
+			}
+
+			PawnBounds[Slot * Pawns.Num() + PawnIndex] = FSphere(Bounds.Origin + Offset, Bounds.SphereRadius);
+		}
+	}
+}
+
+void UFlybotProjectileManager::BuildPawnGrid()
+{
+	// Remove the cells too, keeping empty ones would grow the map with every cell a pawn ever visited.
+	// Cells hold a few pawns inline, so rebuilding them doesn't allocate.
+	PawnGrid.Reset();
+
+	for (int32 PawnIndex = 0; PawnIndex < Pawns.Num(); PawnIndex++)
+	{
+		FBox Box(ForceInit);
+		for (int32 Slot = 0; Slot < RewindSlotSteps.Num(); Slot++)
+		{
+			const FSphere& Bounds = PawnBounds[Slot * Pawns.Num() + PawnIndex];
+			Box += FBox(Bounds.Center - FVector(Bounds.W), Bounds.Center + FVector(Bounds.W));
+		}
+
+		FIntVector Min = GridCell(Box.Min, GridCellSize);
+		FIntVector Max = GridCell(Box.Max, GridCellSize);
+		for (int32 X = Min.X; X <= Max.X; X++)
+			for (int32 Y = Min.Y; Y <= Max.Y; Y++)
+				for (int32 Z = Min.Z; Z <= Max.Z; Z++)
+					PawnGrid.FindOrAdd(FIntVector(X, Y, Z)).Add(PawnIndex);
+	}
+}
+
+/** Distance along the segment where a sphere moving from Start hits Target, or a negative value on a miss. */
+static FORCEINLINE float SweepSphere(const FVector& Start, const FVector& Direction, float Length,
+	const FSphere& Target, float Radius)
+{
+	float CombinedRadius = Target.W + Radius;
+	FVector ToStart = Start - Target.Center;
+	float B = FVector::DotProduct(ToStart, Direction);
+	float C = ToStart.SizeSquared() - CombinedRadius * CombinedRadius;
+
+	// Already overlapping at the start of the segment.
+	if (C <= 0.f)
+		return 0.f;
+
+	// Moving away from the target.
+	if (B > 0.f)
+		return -1.f;
+
+	float Discriminant = B * B - C;
+	if (Discriminant < 0.f)
+		return -1.f;
+
+	float Distance = -B - FMath::Sqrt(Discriminant);
+	return Distance <= Length ? Distance : -1.f;
+}
+
+int32 UFlybotProjectileManager::FindPawnHit(const FVector& Start, const FVector& End, float Radius,
+	const AFlybotPlayerPawn* ShotInstigator, int32 RewindSlot) const
+{
+	FVector Direction = End - Start;
+	float Length = Direction.Size();
+	if (Length <= KINDA_SMALL_NUMBER)
+		return INDEX_NONE;
+
+	Direction /= Length;
+
+	int32 HitPawn = INDEX_NONE;
+	float HitDistance = Length;
+
+	auto TestPawn = [&](int32 PawnIndex)
+	{
+		if (Pawns[PawnIndex] == ShotInstigator)
+			return;
+
+		const FSphere& Bounds = PawnBounds[RewindSlot * Pawns.Num() + PawnIndex];
+		float Distance = SweepSphere(Start, Direction, Length, Bounds, Radius);
+		if (Distance >= 0.f && Distance <= HitDistance)
+		{
+			HitDistance = Distance;
+			HitPawn = PawnIndex;
+		}
+	};
+
+	FIntVector Min = GridCell(Start.ComponentMin(End) - FVector(Radius), GridCellSize);
+	FIntVector Max = GridCell(Start.ComponentMax(End) + FVector(Radius), GridCellSize);
+	FIntVector Size = Max - Min + FIntVector(1);
+
+	// Long segments, usually after a hitch, cover too many cells to be worth walking.
+	if (Size.X * Size.Y * Size.Z > MaxCellsPerShot)
+	{
+		for (int32 PawnIndex = 0; PawnIndex < Pawns.Num(); PawnIndex++)
+		{
+			TestPawn(PawnIndex);
+		}
+
+		return HitPawn;
+	}
+
+	// A pawn overlapping several cells gets tested more than once, which is cheaper than tracking it.
+	for (int32 X = Min.X; X <= Max.X; X++)
+	{
+		for (int32 Y = Min.Y; Y <= Max.Y; Y++)
+		{
+			for (int32 Z = Min.Z; Z <= Max.Z; Z++)
+			{
+				const TArray<int32, TInlineAllocator<4>>* Cell = PawnGrid.Find(FIntVector(X, Y, Z));
+				if (Cell)
+				{
+					for (int32 PawnIndex : *Cell)
+					{
+						TestPawn(PawnIndex);
+					}
+				}
+			}
+		}
+	}
+
+	return HitPawn;
+}
+
+void UFlybotProjectileManager::Tick(float DeltaTime)
+{
+	FLYBOT_SCOPE_CYCLE_COUNTER(STAT_FlybotProjectileManagerTick);
+
+	float Now = GetWorld()->GetTimeSeconds();
+	float PreviousTime = LastTickTime;
+	LastTickTime = Now;
+
+	int32 NumShots = ShotOrigins.Num();
+	SET_DWORD_STAT(STAT_FlybotSimulatedShots, NumShots);
+	if (NumShots == 0)
+		return;
+
+	RewindPawnBounds(Now);
+	BuildPawnGrid();
+
+	// Find hits for all shots. This only reads shared state, so it can be split across threads.
+	ShotHits.SetNumUninitialized(NumShots, false);
+	ParallelFor(NumShots, [&](int32 Index)
+	{
+		const FShotClassInfo& Info = ShotClasses[ShotClassIndices[Index]];
+		float StartDistance = Info.Speed * FMath::Max(PreviousTime - ShotSpawnTimes[Index], 0.f);
+		float EndDistance = FMath::Min(Info.Speed * (Now - ShotSpawnTimes[Index]), ShotMaxDistances[Index]);
+		FVector Start = ShotOrigins[Index] + ShotDirections[Index] * StartDistance;
+		FVector End = ShotOrigins[Index] + ShotDirections[Index] * EndDistance;
+		ShotHits[Index] = FindPawnHit(Start, End, Info.Radius, ShotInstigators[Index].Get(),
+			RewindStepSlots[ShotRewindSteps[Index]]);
+	}, NumShots < ParallelShotThreshold);
+
+	// Apply hits and remove finished shots on the game thread, walking backwards so swaps are safe.
+	for (int32 Index = NumShots - 1; Index >= 0; Index--)
+	{
+		const FShotClassInfo& Info = ShotClasses[ShotClassIndices[Index]];
+
+		if (ShotHits[Index] != INDEX_NONE)
+		{
+			AFlybotPlayerPawn* Target = Pawns[ShotHits[Index]];
+			UE_LOG(LogFlybot, Log, TEXT("Shot hit %s Server"), *Target->GetName());
+			Target->UpdateHealth(Info.HealthDelta);
+			INC_DWORD_STAT(STAT_FlybotShotHits);
+			RemoveShotAtSwap(Index);
+			continue;
+		}
+
+		float Age = Now - ShotSpawnTimes[Index];
+		if (Age >= Info.LifeSpan || Info.Speed * Age >= ShotMaxDistances[Index])
+		{
+			RemoveShotAtSwap(Index);
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,146 @@
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "FlybotProjectileManager.generated.h"
+
+/**
+ * Simulates shots on the dedicated server without spawning actors. Shots fly in a straight line at
+ * a constant speed, so we only need to store where and when they started. All shots are advanced in
+ * one pass per tick and tested against the player pawns using a uniform grid for the broadphase.
+ *
+ * Targets are rewound to where the shooter saw them, using the collision history each pawn records
+ * on the server. Rewind times are rounded to RewindStepTime so all shots from shooters with similar
+ * pings share the same rewound bounds.
+ */
+UCLASS()
+class FLYBOT_API UFlybotProjectileManager : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	UFlybotProjectileManager();
+
+	/** Only simulate shots this way on dedicated servers, clients still need shot actors for visuals. */
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+
+	/** Only simulate shots in worlds where gameplay actually runs. */
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	/** Advance all shots and apply hits. */
+	virtual void Tick(float DeltaTime) override;
+
+	/** Stat used when ticking the subsystem. */
+	virtual TStatId GetStatId() const override;
+
+	/** Add a pawn that shots can hit. */
+	void RegisterPawn(class AFlybotPlayerPawn* Pawn);
+
+	/** Remove a pawn that shots can hit. */
+	void UnregisterPawn(class AFlybotPlayerPawn* Pawn);
+
+	/** Start simulating a shot using the speed, life span, and damage from the ShotClass defaults. */
+	bool AddShot(TSubclassOf<class AFlybotShot> ShotClass, const FVector& Location,
+		const FRotator& Rotation, class AFlybotPlayerPawn* ShotInstigator);
+
+	/** Number of shots currently being simulated. */
+	int32 GetNumShots() const { return ShotOrigins.Num(); }
+
+	/** Size of the cells used for the pawn broadphase grid. */
+	UPROPERTY(EditAnywhere)
+	float GridCellSize;
+
+	/** Use multiple threads to advance shots when there are at least this many. */
+	UPROPERTY(EditAnywhere)
+	int32 ParallelShotThreshold;
+
+	/** Maximum time to rewind targets by for lag compensation, 0 to disable. */
+	UPROPERTY(EditAnywhere, meta = (ClampMin = 0))
+	float MaxRewindTime;
+
+	/** Precision of the rewind time, larger values share rewound bounds between more shooters. */
+	UPROPERTY(EditAnywhere, meta = (ClampMin = 0.001))
+	float RewindStepTime;
+
+private:
+	/** Values copied from a shot class default object so we don't need to look them up for each shot. */
+	struct FShotClassInfo
+	{
+		UClass* Class;
+		float Speed;
+		float LifeSpan;
+		float Radius;
+		float HealthDelta;
+	};
+
+	/** Find or add the info for a shot class. */
+	int32 GetShotClassIndex(TSubclassOf<class AFlybotShot> ShotClass);
+
+	/** Number of RewindStepTime steps to rewind targets by for a shot fired by ShotInstigator. */
+	int32 GetRewindSteps(const class AFlybotPlayerPawn* ShotInstigator) const;
+
+	/** Compute pawn bounds at each rewind time used by the current shots. */
+	void RewindPawnBounds(float Now);
+
+	/** Rebuild the pawn broadphase grid, covering all rewound bounds. */
+	void BuildPawnGrid();
+
+	/** Find the first pawn hit by a shot moving from Start to End, INDEX_NONE if none. */
+	int32 FindPawnHit(const FVector& Start, const FVector& End, float Radius,
+		const class AFlybotPlayerPawn* ShotInstigator, int32 RewindSlot) const;
+
+	/** Remove the shot at Index, swapping the last shot into its place. */
+	void RemoveShotAtSwap(int32 Index);
+
+	/** Pawns that shots can hit. */
+	UPROPERTY()
+	TArray<class AFlybotPlayerPawn*> Pawns;
+
+	/** Collision bounds for each pawn in each rewind slot, gathered once per tick. */
+	TArray<FSphere> PawnBounds;
+
+	/** Rewind slot for each number of rewind steps, INDEX_NONE if no shot uses it this tick. */
+	TArray<int32> RewindStepSlots;
+
+	/** Number of rewind steps for each rewind slot. */
+	TArray<int32> RewindSlotSteps;
+
+	/** Indices into Pawns for each grid cell that a pawn overlaps. */
+	TMap<FIntVector, TArray<int32, TInlineAllocator<4>>> PawnGrid;
+
+	/** Shot classes seen so far. */
+	TArray<FShotClassInfo> ShotClasses;
+
+	/*
+	* Shots, stored as one array per value with the same index used across them.
+	*/
+
+	/** Where each shot started. */
+	TArray<FVector> ShotOrigins;
+
+	/** Unit direction each shot is moving in. */
+	TArray<FVector> ShotDirections;
+
+	/** World time each shot was started. */
+	TArray<float> ShotSpawnTimes;
+
+	/** How far each shot can travel before hitting world geometry. */
+	TArray<float> ShotMaxDistances;
+
+	/** Index into ShotClasses for each shot. */
+	TArray<int32> ShotClassIndices;
+
+	/** Pawn that fired each shot. */
+	TArray<TWeakObjectPtr<class AFlybotPlayerPawn>> ShotInstigators;
+
+	/** How many RewindStepTime steps to rewind targets by for each shot. */
+	TArray<int32> ShotRewindSteps;
+
+	/** Pawn index hit by each shot this tick, INDEX_NONE if none. */
+	TArray<int32> ShotHits;
+
+	/** World time of the last tick, used as the start of this tick's shot segments. */
+	float LastTickTime;
+};
\ No newline at end of file
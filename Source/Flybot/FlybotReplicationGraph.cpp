@@ -0,0 +1,131 @@
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+#include "FlybotReplicationGraph.h"
+#include "Flybot.h"
+#include "FlybotMapRoom.h"
+#include "FlybotPlayerPawn.h"
+#include "EngineUtils.h"
+#include "Engine/NetDriver.h"
+#include "ReplicationGraphTypes.h"
+
+UFlybotReplicationGraph::UFlybotReplicationGraph()
+{
+	DefaultCellSize = 10000.f;
+	MinCellSize = 5000.f;
+	MaxCellSize = 40000.f;
+	DefaultSpatialBias = FVector2D(-200000.f, -200000.f);
+	GridNode = nullptr;
+	AlwaysRelevantNode = nullptr;
+}
+
+/** Replication settings for an actor class, taken from its default object. */
+static FClassReplicationInfo MakeClassInfo(const AActor* Actor, float FrameRate)
+{
+	FClassReplicationInfo Info;
+	Info.SetCullDistanceSquared(Actor->NetCullDistanceSquared);
+	Info.ReplicationPeriodFrame = FMath::Max<uint32>(
+		FMath::RoundToFloat(FrameRate / FMath::Max(Actor->NetUpdateFrequency, 1.f)), 1);
+	return Info;
+}
+
+void UFlybotReplicationGraph::InitGlobalActorClassSettings()
+{
+	Super::InitGlobalActorClassSettings();
+
+	float FrameRate = NetDriver ? float(NetDriver->NetServerMaxTickRate) : 30.f;
+	GlobalActorReplicationInfoMap.SetClassInfo(AActor::StaticClass(),
+		MakeClassInfo(GetDefault<AActor>(), FrameRate));
+	GlobalActorReplicationInfoMap.SetClassInfo(AFlybotPlayerPawn::StaticClass(),
+		MakeClassInfo(GetDefault<AFlybotPlayerPawn>(), FrameRate));
+}
+
+void UFlybotReplicationGraph::InitGlobalGraphNodes()
+{
+	Super::InitGlobalGraphNodes();
+
+	GridNode = CreateNewNode<UReplicationGraphNode_GridSpatialization2D>();
+	UpdateGridLayout();
+	AddGlobalGraphNode(GridNode);
+
+	AlwaysRelevantNode = CreateNewNode<UReplicationGraphNode_ActorList>();
+	AddGlobalGraphNode(AlwaysRelevantNode);
+}
+
+void UFlybotReplicationGraph::UpdateGridLayout()
+{
+	// Lay the grid out from the map rooms. One cell covers about one room with its tubes, so pawns
+	// in the same room share a cell, and the grid starts at the edge of the map so every room is
+	// inside it.
+	float CellSize = 0.f;
+	FBox MapBounds(ForceInit);
+	for (TActorIterator<AFlybotMapRoom> It(GetWorld()); It; ++It)
+	{
+		FBox RoomBounds = It->GetRoomBounds(true);
+		FVector RoomSize = RoomBounds.GetSize();
+		CellSize = FMath::Max3(CellSize, RoomSize.X, RoomSize.Y);
+		MapBounds += RoomBounds;
+	}
+
+	if (MapBounds.IsValid)
+	{
+		// Pawns are added to every cell within their cull distance, so leave room for that past the map.
+		float CullDistance = FMath::Sqrt(GetDefault<AFlybotPlayerPawn>()->NetCullDistanceSquared);
+		GridNode->CellSize = FMath::Clamp(CellSize, MinCellSize, MaxCellSize);
+		GridNode->SpatialBias = FVector2D(MapBounds.Min.X - CullDistance, MapBounds.Min.Y - CullDistance);
+	}
+	else
+	{
+		GridNode->CellSize = DefaultCellSize;
+		GridNode->SpatialBias = DefaultSpatialBias;
+	}
+
+	// Actors already in the grid were bucketed with the old layout.
+	GridNode->ForceRebuild();
+	UE_LOG(LogFlybot, Log, TEXT("Replication grid cell size %.0f, origin %s"),
+		GridNode->CellSize, *GridNode->SpatialBias.ToString());
+}
+
+void UFlybotReplicationGraph::InitConnectionGraphNodes(UNetReplicationGraphConnection* RepGraphConnection)
+{
+	Super::InitConnectionGraphNodes(RepGraphConnection);
+
+	// Replicates the connection's player controller, pawn and view target.
+	UReplicationGraphNode_AlwaysRelevant_ForConnection* ForConnectionNode =
+		CreateNewNode<UReplicationGraphNode_AlwaysRelevant_ForConnection>();
+	AddConnectionGraphNode(ForConnectionNode, RepGraphConnection);
+}
+
+bool UFlybotReplicationGraph::IsSpatialized(const AActor* Actor) const
+{
+	return !Actor->bAlwaysRelevant && !Actor->bOnlyRelevantToOwner;
+}
+
+void UFlybotReplicationGraph::RouteAddNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo,
+	FGlobalActorReplicationInfo& GlobalInfo)
+{
+	const AActor* Actor = ActorInfo.Actor;
+	if (Actor->bAlwaysRelevant)
+	{
+		AlwaysRelevantNode->NotifyAddNetworkActor(ActorInfo);
+	}
+	else if (IsSpatialized(Actor))
+	{
+		// Pawns carry their replicated state, such as bShooting, so this also limits who gets it.
+		GridNode->AddActor_Dynamic(ActorInfo, GlobalInfo);
+	}
+
+	// Owner only actors are handled by the connection node.
+}
+
+void UFlybotReplicationGraph::RouteRemoveNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo)
+{
+	const AActor* Actor = ActorInfo.Actor;
+	if (Actor->bAlwaysRelevant)
+	{
+		AlwaysRelevantNode->NotifyRemoveNetworkActor(ActorInfo);
+	}
+	else if (IsSpatialized(Actor))
+	{
+		GridNode->RemoveActor_Dynamic(ActorInfo);
+	}
+}
\ No newline at end of file
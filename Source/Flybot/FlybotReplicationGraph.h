@@ -0,0 +1,71 @@
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ReplicationGraph.h"
+#include "FlybotReplicationGraph.generated.h"
+
+/**
+ * Replication graph that routes pawns through a spatial grid laid out from the map rooms, so each
+ * connection only considers the pawns in its own cell instead of distance checking every pawn.
+ * Enabled with ReplicationDriverClassName in the net driver config.
+ */
+UCLASS(Transient, Config = Engine)
+class FLYBOT_API UFlybotReplicationGraph : public UReplicationGraph
+{
+	GENERATED_BODY()
+
+public:
+	UFlybotReplicationGraph();
+
+	/** Setup replication settings for the pawn class. */
+	virtual void InitGlobalActorClassSettings() override;
+
+	/** Create the spatial grid and always relevant nodes. */
+	virtual void InitGlobalGraphNodes() override;
+
+	/** Create the node that replicates the connection's own controller and pawn. */
+	virtual void InitConnectionGraphNodes(UNetReplicationGraphConnection* RepGraphConnection) override;
+
+	/** Add a new actor to the grid or always relevant list. */
+	virtual void RouteAddNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo,
+		FGlobalActorReplicationInfo& GlobalInfo) override;
+
+	/** Remove an actor from the node it was added to. */
+	virtual void RouteRemoveNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo) override;
+
+	/**
+	 * Lay the grid out again from the map rooms. The graph is created before the game mode generates
+	 * its map, so AFlybotMapGenerator calls this once the generated rooms are spawned.
+	 */
+	void UpdateGridLayout();
+
+	/** Cell size to use when the map has no rooms to lay out the grid from. */
+	UPROPERTY(Config)
+	float DefaultCellSize;
+
+	/** Smallest cell size to use, small rooms would otherwise put pawns in too many cells. */
+	UPROPERTY(Config)
+	float MinCellSize;
+
+	/** Largest cell size to use, large rooms would otherwise put too many pawns in one cell. */
+	UPROPERTY(Config)
+	float MaxCellSize;
+
+	/** Grid origin to use when the map has no rooms to lay out the grid from. */
+	UPROPERTY(Config)
+	FVector2D DefaultSpatialBias;
+
+private:
+	/** Whether an actor should go in the spatial grid. */
+	bool IsSpatialized(const AActor* Actor) const;
+
+	/** Pawns and other moving actors, bucketed by location. */
+	UPROPERTY()
+	class UReplicationGraphNode_GridSpatialization2D* GridNode;
+
+	/** Actors every connection always needs, such as the game state and player states. */
+	UPROPERTY()
+	class UReplicationGraphNode_ActorList* AlwaysRelevantNode;
+};
\ No newline at end of file
@@ -0,0 +1,317 @@
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+#include "FlybotServerStats.h"
+#include "Flybot.h"
+#include "FlybotGameMode.h"
+#include "FlybotPlayerPawn.h"
+#include "Engine/NetConnection.h"
+#include "Engine/NetDriver.h"
+#include "EngineUtils.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+static TAutoConsoleVariable<float> CVarFlybotServerStatsInterval(
+	TEXT("Flybot.ServerStatsInterval"),
+	0.f,
+	TEXT("Seconds between server stats reports in the log, 0 to disable."));
+
+static TAutoConsoleVariable<float> CVarFlybotMetricsInterval(
+	TEXT("Flybot.MetricsInterval"),
+	15.f,
+	TEXT("Seconds between writing Prometheus metrics on dedicated servers, 0 to disable."));
+
+static TAutoConsoleVariable<FString> CVarFlybotMetricsFile(
+	TEXT("Flybot.MetricsFile"),
+	TEXT(""),
+	TEXT("File to write Prometheus metrics to, Saved/Metrics/Flybot.prom if empty."));
+
+/** Weight of each new frame in SmoothedFrameSeconds, about a second of frames at 30 frames per second. */
+static constexpr double FrameTimeSmoothing = 0.05;
+
+const double UFlybotServerStats::FrameBucketBounds[NumFrameBuckets - 1] = {
+	0.001, 0.002, 0.004, 0.008, 0.012, 0.016, 0.025, 0.033, 0.05, 0.1, 0.25 };
+
+FFlybotPlayerNetStats::FFlybotPlayerNetStats()
+{
+	ServerTransformUpdates = 0;
+	MovesReceived = 0;
+	Corrections = 0;
+	MovingTooFast = 0;
+}
+
+UFlybotServerStats::UFlybotServerStats()
+{
+	FrameStartTime = 0.0;
+	ReportStartTime = 0.0;
+	MetricsWriteTime = 0.0;
+	Frames = 0;
+	FrameSeconds = 0.0;
+	MaxFrameSeconds = 0.0;
+	BandwidthSamples = 0;
+	OutBytesPerSecond = 0;
+	InBytesPerSecond = 0;
+	Connections = 0;
+	Players = 0;
+	SmoothedFrameSeconds = 0.0;
+	CurrentOutBytesPerConnection = 0.0;
+	Corrections = 0;
+	FMemory::Memzero(FrameBuckets);
+	FMemory::Memzero(RecentFrameBuckets);
+	TotalFrameSeconds = 0.0;
+	TotalServerTransformUpdates = 0;
+	TotalMovesReceived = 0;
+	TotalCorrections = 0;
+	TotalMovingTooFast = 0;
+	TotalShots = 0;
+}
+
+bool UFlybotServerStats::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UFlybotServerStats::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UFlybotServerStats, STATGROUP_Tickables);
+}
+
+void UFlybotServerStats::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	// The tick delta includes the time spent waiting for the next server frame, so time the frame
+	// from receiving packets to sending them instead.
+	TickDispatchHandle = InWorld.OnTickDispatch().AddUObject(this, &UFlybotServerStats::OnTickDispatch);
+	PostTickFlushHandle = InWorld.OnPostTickFlush().AddUObject(this, &UFlybotServerStats::OnPostTickFlush);
+	ReportStartTime = FPlatformTime::Seconds();
+	MetricsWriteTime = ReportStartTime;
+}
+
+void UFlybotServerStats::Deinitialize()
+{
+	UWorld* World = GetWorld();
+	World->OnTickDispatch().Remove(TickDispatchHandle);
+	World->OnPostTickFlush().Remove(PostTickFlushHandle);
+
+	Super::Deinitialize();
+}
+
+void UFlybotServerStats::AddServerTransformUpdate(FFlybotPlayerNetStats& PlayerStats, int32 NumMoves)
+{
+	PlayerStats.ServerTransformUpdates++;
+	PlayerStats.MovesReceived += NumMoves;
+	TotalServerTransformUpdates++;
+	TotalMovesReceived += NumMoves;
+}
+
+void UFlybotServerStats::AddCorrection(FFlybotPlayerNetStats& PlayerStats, bool bMovingTooFast)
+{
+	PlayerStats.Corrections++;
+	PlayerStats.MovingTooFast += bMovingTooFast;
+	Corrections++;
+	TotalCorrections++;
+	TotalMovingTooFast += bMovingTooFast;
+}
+
+void UFlybotServerStats::OnTickDispatch(float DeltaSeconds)
+{
+	FrameStartTime = FPlatformTime::Seconds();
+}
+
+void UFlybotServerStats::OnPostTickFlush()
+{
+	if (FrameStartTime == 0.0)
+		return;
+
+	double Seconds = FPlatformTime::Seconds() - FrameStartTime;
+	Frames++;
+	FrameSeconds += Seconds;
+	MaxFrameSeconds = FMath::Max(MaxFrameSeconds, Seconds);
+	SmoothedFrameSeconds = FMath::Lerp(SmoothedFrameSeconds, Seconds, FrameTimeSmoothing);
+
+	int32 Bucket = 0;
+	while (Bucket < NumFrameBuckets - 1 && Seconds > FrameBucketBounds[Bucket])
+	{
+		Bucket++;
+	}
+
+	FrameBuckets[Bucket]++;
+	RecentFrameBuckets[Bucket]++;
+	TotalFrameSeconds += Seconds;
+}
+
+void UFlybotServerStats::Tick(float DeltaTime)
+{
+	UNetDriver* NetDriver = GetWorld()->GetNetDriver();
+	if (!NetDriver || !NetDriver->IsServer())
+		return;
+
+	Connections = NetDriver->ClientConnections.Num();
+	Players = 0;
+	int64 ConnectionOutBytesPerSecond = 0;
+	for (UNetConnection* Connection : NetDriver->ClientConnections)
+	{
+		Players += 1 + Connection->Children.Num();
+		ConnectionOutBytesPerSecond += Connection->OutBytesPerSecond;
+	}
+
+	CurrentOutBytesPerConnection = Connections ? double(ConnectionOutBytesPerSecond) / Connections : 0.0;
+
+	double Now = FPlatformTime::Seconds();
+	float ReportInterval = CVarFlybotServerStatsInterval.GetValueOnGameThread();
+	if (ReportInterval > 0.f)
+	{
+		// Connections update their rates once a second, so sample every tick and average.
+		for (UNetConnection* Connection : NetDriver->ClientConnections)
+		{
+			OutBytesPerSecond += Connection->OutBytesPerSecond;
+			InBytesPerSecond += Connection->InBytesPerSecond;
+		}
+
+		BandwidthSamples++;
+		if (Now - ReportStartTime >= ReportInterval)
+		{
+			Report(Now - ReportStartTime);
+		}
+	}
+
+	float MetricsInterval = CVarFlybotMetricsInterval.GetValueOnGameThread();
+	if (MetricsInterval > 0.f && IsRunningDedicatedServer() && Now - MetricsWriteTime >= MetricsInterval)
+	{
+		FString Path = CVarFlybotMetricsFile.GetValueOnGameThread();
+		WriteMetrics(Path.IsEmpty() ? FPaths::ProjectSavedDir() / TEXT("Metrics/Flybot.prom") : Path);
+		MetricsWriteTime = Now;
+	}
+}
+
+void UFlybotServerStats::Report(double Seconds)
+{
+	// Split screen players share their parent's connection, so also report bandwidth per player.
+	double ConnectionSamples = FMath::Max(double(BandwidthSamples) * Connections, 1.0);
+	double PlayerSamples = FMath::Max(double(BandwidthSamples) * Players, 1.0);
+
+	UE_LOG(LogFlybot, Log,
+		TEXT("ServerStats Players=%d Connections=%d Frames=%d FrameRate=%.1f AvgFrameMs=%.3f MaxFrameMs=%.3f ")
+		TEXT("OutBytesPerConnection=%.0f InBytesPerConnection=%.0f OutBytesPerPlayer=%.0f Corrections=%d ")
+		TEXT("CorrectionsPerSecond=%.2f"),
+		Players, Connections, Frames, Frames / Seconds, Frames ? FrameSeconds * 1000.0 / Frames : 0.0,
+		MaxFrameSeconds * 1000.0, OutBytesPerSecond / ConnectionSamples, InBytesPerSecond / ConnectionSamples,
+		OutBytesPerSecond / PlayerSamples, Corrections, Corrections / Seconds);
+
+	ReportStartTime = FPlatformTime::Seconds();
+	Frames = 0;
+	FrameSeconds = 0.0;
+	MaxFrameSeconds = 0.0;
+	BandwidthSamples = 0;
+	OutBytesPerSecond = 0;
+	InBytesPerSecond = 0;
+	Corrections = 0;
+}
+
+double UFlybotServerStats::GetFrameQuantile(const uint64* Buckets, double Fraction)
+{
+	uint64 Total = 0;
+	for (int32 Bucket = 0; Bucket < NumFrameBuckets; Bucket++)
+	{
+		Total += Buckets[Bucket];
+	}
+
+	// Frames past the last bound are reported at the last bound, Prometheus does the same.
+	uint64 Count = 0;
+	for (int32 Bucket = 0; Bucket < NumFrameBuckets - 1; Bucket++)
+	{
+		Count += Buckets[Bucket];
+		if (Total > 0 && Count >= Total * Fraction)
+			return FrameBucketBounds[Bucket];
+	}
+
+	return Total > 0 ? FrameBucketBounds[NumFrameBuckets - 2] : 0.0;
+}
+
+void UFlybotServerStats::WriteMetrics(const FString& Path)
+{
+	UNetDriver* NetDriver = GetWorld()->GetNetDriver();
+	AFlybotGameMode* GameMode = GetWorld()->GetAuthGameMode<AFlybotGameMode>();
+	MetricsText.Reset();
+
+	auto AddHeader = [this](const TCHAR* Name, const TCHAR* Type, const TCHAR* Help)
+	{
+		MetricsText.Appendf(TEXT("# HELP %s %s\n# TYPE %s %s\n"), Name, Help, Name, Type);
+	};
+
+	AddHeader(TEXT("flybot_frame_seconds"), TEXT("histogram"),
+		TEXT("Server frame time from receiving packets to sending them."));
+	uint64 Count = 0;
+	for (int32 Bucket = 0; Bucket < NumFrameBuckets - 1; Bucket++)
+	{
+		Count += FrameBuckets[Bucket];
+		MetricsText.Appendf(TEXT("flybot_frame_seconds_bucket{le=\"%g\"} %llu\n"), FrameBucketBounds[Bucket], Count);
+	}
+	Count += FrameBuckets[NumFrameBuckets - 1];
+	MetricsText.Appendf(TEXT("flybot_frame_seconds_bucket{le=\"+Inf\"} %llu\n"), Count);
+	MetricsText.Appendf(TEXT("flybot_frame_seconds_sum %f\nflybot_frame_seconds_count %llu\n"), TotalFrameSeconds, Count);
+
+	AddHeader(TEXT("flybot_frame_seconds_recent"), TEXT("gauge"),
+		TEXT("Server frame time percentiles since the last write, rounded up to histogram bounds."));
+	const double Quantiles[] = { 0.5, 0.9, 0.99 };
+	for (double Quantile : Quantiles)
+	{
+		MetricsText.Appendf(TEXT("flybot_frame_seconds_recent{quantile=\"%g\"} %g\n"),
+			Quantile, GetFrameQuantile(RecentFrameBuckets, Quantile));
+	}
+	FMemory::Memzero(RecentFrameBuckets);
+
+	AddHeader(TEXT("flybot_players"), TEXT("gauge"), TEXT("Connected players, including split screen players."));
+	MetricsText.Appendf(TEXT("flybot_players %d\n"), Players);
+	AddHeader(TEXT("flybot_connections"), TEXT("gauge"), TEXT("Client connections."));
+	MetricsText.Appendf(TEXT("flybot_connections %d\n"), Connections);
+	AddHeader(TEXT("flybot_free_player_starts"), TEXT("gauge"), TEXT("Player starts left for new players."));
+	MetricsText.Appendf(TEXT("flybot_free_player_starts %d\n"), GameMode ? GameMode->GetNumFreePlayerStarts() : 0);
+
+	AddHeader(TEXT("flybot_server_transform_updates_total"), TEXT("counter"), TEXT("UpdateServerTransform calls."));
+	MetricsText.Appendf(TEXT("flybot_server_transform_updates_total %llu\n"), TotalServerTransformUpdates);
+	AddHeader(TEXT("flybot_moves_received_total"), TEXT("counter"), TEXT("Client moves received."));
+	MetricsText.Appendf(TEXT("flybot_moves_received_total %llu\n"), TotalMovesReceived);
+	AddHeader(TEXT("flybot_corrections_total"), TEXT("counter"), TEXT("Transform corrections sent to clients."));
+	MetricsText.Appendf(TEXT("flybot_corrections_total %llu\n"), TotalCorrections);
+	AddHeader(TEXT("flybot_moving_too_fast_total"), TEXT("counter"), TEXT("Moves rejected for moving too fast."));
+	MetricsText.Appendf(TEXT("flybot_moving_too_fast_total %llu\n"), TotalMovingTooFast);
+	AddHeader(TEXT("flybot_shots_total"), TEXT("counter"), TEXT("Shots fired."));
+	MetricsText.Appendf(TEXT("flybot_shots_total %llu\n"), TotalShots);
+
+	// Net driver totals are 32 bit and wrap, which Prometheus treats as a counter reset.
+	AddHeader(TEXT("flybot_net_in_bytes_total"), TEXT("counter"), TEXT("Bytes received from clients."));
+	MetricsText.Appendf(TEXT("flybot_net_in_bytes_total %u\n"), NetDriver ? NetDriver->InTotalBytes : 0);
+	AddHeader(TEXT("flybot_net_out_bytes_total"), TEXT("counter"), TEXT("Bytes sent to clients."));
+	MetricsText.Appendf(TEXT("flybot_net_out_bytes_total %u\n"), NetDriver ? NetDriver->OutTotalBytes : 0);
+
+	// Per player counters, so a single misbehaving client stands out.
+	auto AddPlayerCounter = [this](const TCHAR* Name, const TCHAR* Help, uint32 FFlybotPlayerNetStats::* Counter)
+	{
+		MetricsText.Appendf(TEXT("# HELP %s %s\n# TYPE %s counter\n"), Name, Help, Name);
+		for (TActorIterator<AFlybotPlayerPawn> It(GetWorld()); It; ++It)
+		{
+			if (const AController* Controller = It->GetController())
+			{
+				MetricsText.Appendf(TEXT("%s{player=\"%s\"} %u\n"), Name, *Controller->GetName(),
+					It->GetNetStats().*Counter);
+			}
+		}
+	};
+
+	AddPlayerCounter(TEXT("flybot_player_server_transform_updates_total"),
+		TEXT("UpdateServerTransform calls per player."), &FFlybotPlayerNetStats::ServerTransformUpdates);
+	AddPlayerCounter(TEXT("flybot_player_corrections_total"),
+		TEXT("Corrections sent per player."), &FFlybotPlayerNetStats::Corrections);
+	AddPlayerCounter(TEXT("flybot_player_moving_too_fast_total"),
+		TEXT("Moves rejected for moving too fast per player."), &FFlybotPlayerNetStats::MovingTooFast);
+
+	// Collectors may read the file at any time, so write a temporary file and move it into place.
+	FString TempPath = Path + TEXT(".tmp");
+	if (!FFileHelper::SaveStringToFile(MetricsText, *TempPath) || !IFileManager::Get().Move(*Path, *TempPath))
+	{
+		UE_LOG(LogFlybot, Warning, TEXT("Could not write metrics to %s"), *Path);
+	}
+}
@@ -0,0 +1,150 @@
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "FlybotServerStats.generated.h"
+
+/** Server stats for one player, kept on their pawn and exported with a player label. */
+struct FLYBOT_API FFlybotPlayerNetStats
+{
+	/** UpdateServerTransform calls received from the client. */
+	uint32 ServerTransformUpdates;
+
+	/** Moves received in those calls. */
+	uint32 MovesReceived;
+
+	/** Transform corrections sent to the client. */
+	uint32 Corrections;
+
+	/** Corrections sent because the client moved faster than the game allows. */
+	uint32 MovingTooFast;
+
+	FFlybotPlayerNetStats();
+};
+
+/**
+ * Collects server frame time, bandwidth, player counts, moves, corrections and shots.
+ *
+ * Every Flybot.ServerStatsInterval seconds a report is logged as a single line starting with
+ * "ServerStats", so load test scripts can parse it from the server log. Dedicated servers also write
+ * all stats in Prometheus text format to Flybot.MetricsFile every Flybot.MetricsInterval seconds, for
+ * the node exporter textfile collector to pick up. Events only bump preallocated counters, so this is
+ * cheap enough to leave on all the time.
+ */
+UCLASS()
+class FLYBOT_API UFlybotServerStats : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	UFlybotServerStats();
+
+	/** Only collect stats in worlds where gameplay actually runs. */
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	/** Hook into the start and end of each world tick to time the whole server frame. */
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+
+	/** Remove the world tick hooks. */
+	virtual void Deinitialize() override;
+
+	/** Sample bandwidth, log a report and write metrics when their intervals are up. */
+	virtual void Tick(float DeltaTime) override;
+
+	/** Stat used when ticking the subsystem. */
+	virtual TStatId GetStatId() const override;
+
+	/** Count moves received from a player in one UpdateServerTransform call. */
+	void AddServerTransformUpdate(FFlybotPlayerNetStats& PlayerStats, int32 NumMoves);
+
+	/** Count a transform correction sent to a player, and whether it was for moving too fast. */
+	void AddCorrection(FFlybotPlayerNetStats& PlayerStats, bool bMovingTooFast);
+
+	/** Count a shot fired on the server. */
+	void AddShot() { TotalShots++; }
+
+	/** Server frame time averaged over roughly the last second, used for admission control. */
+	double GetSmoothedFrameSeconds() const { return SmoothedFrameSeconds; }
+
+	/** Bytes per second currently sent to each connection on average. */
+	double GetOutBytesPerConnection() const { return CurrentOutBytesPerConnection; }
+
+private:
+	/** Upper bounds of the frame time histogram buckets in seconds, the last bucket has no bound. */
+	static constexpr int32 NumFrameBuckets = 12;
+	static const double FrameBucketBounds[NumFrameBuckets - 1];
+
+	/** Log the stats collected since the last report and start over. */
+	void Report(double Seconds);
+
+	/** Write all stats to the metrics file, replacing it in one move so readers never see half a file. */
+	void WriteMetrics(const FString& Path);
+
+	/** Frame time below which Fraction of the frames in the buckets fall, using bucket upper bounds. */
+	static double GetFrameQuantile(const uint64* Buckets, double Fraction);
+
+	/** Start timing a frame, called before the net driver receives packets. */
+	void OnTickDispatch(float DeltaSeconds);
+
+	/** Finish timing a frame, called after the net driver sends packets. */
+	void OnPostTickFlush();
+
+	/** Time the current frame started. */
+	double FrameStartTime;
+
+	/** Time the current report interval started. */
+	double ReportStartTime;
+
+	/** Time the metrics were last written. */
+	double MetricsWriteTime;
+
+	/** Frames timed this interval. */
+	int32 Frames;
+
+	/** Total and longest frame time this interval, in seconds. */
+	double FrameSeconds;
+	double MaxFrameSeconds;
+
+	/** Bandwidth samples this interval, summed across connections. */
+	int32 BandwidthSamples;
+	int64 OutBytesPerSecond;
+	int64 InBytesPerSecond;
+
+	/** Connections and players at the last sample. */
+	int32 Connections;
+	int32 Players;
+
+	/** Exponential moving average of the frame time, updated every frame. */
+	double SmoothedFrameSeconds;
+
+	/** Average bytes per second sent to each connection at the last tick. */
+	double CurrentOutBytesPerConnection;
+
+	/** Corrections sent this interval. */
+	int32 Corrections;
+
+	/*
+	* Totals since the server started, exported as Prometheus counters.
+	*/
+
+	/** Frames in each histogram bucket, and the total time of all frames. */
+	uint64 FrameBuckets[NumFrameBuckets];
+	double TotalFrameSeconds;
+
+	/** Frames in each histogram bucket since the metrics were last written, for percentiles. */
+	uint64 RecentFrameBuckets[NumFrameBuckets];
+
+	uint64 TotalServerTransformUpdates;
+	uint64 TotalMovesReceived;
+	uint64 TotalCorrections;
+	uint64 TotalMovingTooFast;
+	uint64 TotalShots;
+
+	/** Metrics text, kept between writes so the buffer is reused. */
+	FString MetricsText;
+
+	FDelegateHandle TickDispatchHandle;
+	FDelegateHandle PostTickFlushHandle;
+};
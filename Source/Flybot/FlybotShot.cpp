@@ -3,11 +3,14 @@
 #include "FlybotShot.h"
 #include "Flybot.h"
 #include "FlybotPlayerPawn.h"
+#include "FlybotShotPool.h"
 #include "Components/SphereComponent.h"
 #include "GameFramework/ProjectileMovementComponent.h"
 #include "NiagaraComponent.h"
 #include "NiagaraFunctionLibrary.h"
 
+DECLARE_CYCLE_STAT(TEXT("Shot Hit"), STAT_FlybotShotHit, STATGROUP_Flybot);
+
 AFlybotShot::AFlybotShot()
 {
 	Collision = CreateDefaultSubobject<USphereComponent>(TEXT("Collision"));
@@ -24,16 +27,75 @@ AFlybotShot::AFlybotShot()
 	Movement->MaxSpeed = 20000.f;
 	Movement->ProjectileGravityScale = 0.f;
 
-	// Destroy after moving 40k units (life span * speed) to match the net cull distance
+	// Return to the pool after moving 40k units (life span * speed) to match the net cull distance
 	// in the player pawn.
 	InitialLifeSpan = 2.f;
 	HealthDelta = -1.f;
 	PowerDelta = -1.f;
+	bShotActive = true;
+}
+
+void AFlybotShot::LifeSpanExpired()
+{
+	ReleaseShot();
+}
+
+void AFlybotShot::ActivateShot(const FVector& Location, const FRotator& Rotation, APawn* ShotInstigator)
+{
+	bShotActive = true;
+	SetInstigator(ShotInstigator);
+	SetActorLocationAndRotation(Location, Rotation, false, nullptr, ETeleportType::ResetPhysics);
+	SetActorHiddenInGame(false);
+	SetActorEnableCollision(true);
+	SetLifeSpan(InitialLifeSpan);
+
+	// The projectile component clears the updated component when it stops on a hit.
+	Movement->SetUpdatedComponent(Collision);
+	Movement->Velocity = Rotation.Vector() * Movement->InitialSpeed;
+	Movement->UpdateComponentVelocity();
+	Movement->SetComponentTickEnabled(true);
+
+	FlySystemComponent->Activate(true);
+}
+
+void AFlybotShot::DeactivateShot()
+{
+	bShotActive = false;
+	SetInstigator(nullptr);
+	SetActorHiddenInGame(true);
+	SetActorEnableCollision(false);
+	SetLifeSpan(0.f);
+
+	Movement->StopMovementImmediately();
+	Movement->SetComponentTickEnabled(false);
+
+	FlySystemComponent->DeactivateImmediate();
+}
+
+void AFlybotShot::ReleaseShot()
+{
+	UFlybotShotPool* ShotPool = GetWorld()->GetSubsystem<UFlybotShotPool>();
+	if (ShotPool)
+	{
+		ShotPool->ReleaseShot(this);
+	}
+	else
+	{
+		Destroy();
+	}
 }
 
 void AFlybotShot::OnHit(UPrimitiveComponent* HitComponent, AActor* OtherActor, UPrimitiveComponent* OtherComponent,
 	FVector NormalImpulse, const FHitResult& Hit)
 {
+	FLYBOT_SCOPE_CYCLE_COUNTER(STAT_FlybotShotHit);
+
+	// We may still get hits from the rest of the move after being released.
+	if (!bShotActive)
+	{
+		return;
+	}
+
 	UE_LOG(LogFlybot, Log, TEXT("Shot hit %s %s"), *OtherActor->GetName(),
 		IsNetMode(NM_Client) ? TEXT("Client") : TEXT("Server"));
 
@@ -42,6 +104,7 @@ void AFlybotShot::OnHit(UPrimitiveComponent* HitComponent, AActor* OtherActor, U
 	if (Target && Target != Shooter && Target->GetLocalRole() == ROLE_Authority)
 	{
 		Target->UpdateHealth(HealthDelta);
+		INC_DWORD_STAT(STAT_FlybotShotHits);
 	}
 
 	if (HitSystem)
@@ -50,5 +113,5 @@ void AFlybotShot::OnHit(UPrimitiveComponent* HitComponent, AActor* OtherActor, U
 			Collision->GetComponentLocation(), Collision->GetComponentRotation());
 	}
 
-	Destroy();
+	ReleaseShot();
 }
\ No newline at end of file
@@ -14,6 +14,18 @@ class FLYBOT_API AFlybotShot : public AActor
 public:
 	AFlybotShot();
 
+	/** Return the shot to the pool instead of destroying it when the life span runs out. */
+	virtual void LifeSpanExpired() override;
+
+	/** Start flying from the given location, used when handing the shot out from the pool. */
+	void ActivateShot(const FVector& Location, const FRotator& Rotation, class APawn* ShotInstigator);
+
+	/** Stop moving, hide, and reset state so the shot can be reused by the pool. */
+	void DeactivateShot();
+
+	/** Whether the shot is currently flying. */
+	bool IsShotActive() const { return bShotActive; }
+
 	/** Collision handling function. */
 	UFUNCTION()
 	void OnHit(UPrimitiveComponent* HitComponent, AActor* OtherActor, UPrimitiveComponent* OtherComponent,
@@ -42,4 +54,11 @@ public:
 	/** How much to change power by when using this shot. */
 	UPROPERTY(EditAnywhere)
 	float PowerDelta;
+
+private:
+	/** Release to the pool if there is one, otherwise destroy. */
+	void ReleaseShot();
+
+	/** Whether the shot is currently flying or waiting in the pool. */
+	bool bShotActive;
 };
\ No newline at end of file
@@ -0,0 +1,144 @@
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+#include "FlybotShotPool.h"
+#include "Flybot.h"
+#include "FlybotShot.h"
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Shot Pool Hits"), STAT_FlybotShotPoolHits, STATGROUP_Flybot);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Shot Pool Misses"), STAT_FlybotShotPoolMisses, STATGROUP_Flybot);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Shot Pool Size"), STAT_FlybotShotPoolSize, STATGROUP_Flybot);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Live Shots"), STAT_FlybotLiveShots, STATGROUP_Flybot);
+
+FFlybotShotPoolEntry::FFlybotShotPoolEntry()
+{
+	bPrewarmed = false;
+}
+
+UFlybotShotPool::UFlybotShotPool()
+{
+	PoolHits = 0;
+	PoolMisses = 0;
+	PoolSize = 0;
+	LiveShots = 0;
+}
+
+bool UFlybotShotPool::ShouldCreateSubsystem(UObject* Outer) const
+{
+	return !IsRunningDedicatedServer() && Super::ShouldCreateSubsystem(Outer);
+}
+
+bool UFlybotShotPool::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UFlybotShotPool::Deinitialize()
+{
+	UE_LOG(LogFlybot, Log, TEXT("Shot pool for %s: %u shots, %u hits, %u misses"),
+		*GetWorld()->GetMapName(), PoolSize, PoolHits, PoolMisses);
+
+	DEC_DWORD_STAT_BY(STAT_FlybotShotPoolSize, PoolSize);
+
+	// Shots still active when the world goes away are never released, so take them off the stat too.
+	DEC_DWORD_STAT_BY(STAT_FlybotLiveShots, LiveShots);
+	LiveShots = 0;
+	Pools.Empty();
+	Super::Deinitialize();
+}
+
+void UFlybotShotPool::Prewarm(TSubclassOf<AFlybotShot> ShotClass, int32 Count)
+{
+	if (!ShotClass)
+	{
+		return;
+	}
+
+	FFlybotShotPoolEntry& Pool = Pools.FindOrAdd(ShotClass);
+	if (Pool.bPrewarmed)
+	{
+		return;
+	}
+
+	Pool.bPrewarmed = true;
+	while (Pool.FreeShots.Num() < Count)
+	{
+		AFlybotShot* Shot = SpawnShot(ShotClass, FVector::ZeroVector, FRotator::ZeroRotator);
+		if (!Shot)
+		{
+			break;
+		}
+
+		Shot->DeactivateShot();
+		Pool.FreeShots.Add(Shot);
+	}
+}
+
+AFlybotShot* UFlybotShotPool::AcquireShot(TSubclassOf<AFlybotShot> ShotClass,
+	const FVector& Location, const FRotator& Rotation, APawn* ShotInstigator)
+{
+	if (!ShotClass)
+	{
+		return nullptr;
+	}
+
+	AFlybotShot* Shot = nullptr;
+	FFlybotShotPoolEntry& Pool = Pools.FindOrAdd(ShotClass);
+
+	// Skip any shots that were destroyed out from under us, such as during level streaming.
+	while (!Shot && Pool.FreeShots.Num() > 0)
+	{
+		Shot = Pool.FreeShots.Pop(false);
+		if (!IsValid(Shot))
+		{
+			Shot = nullptr;
+		}
+	}
+
+	if (Shot)
+	{
+		PoolHits++;
+		INC_DWORD_STAT(STAT_FlybotShotPoolHits);
+	}
+	else
+	{
+		Shot = SpawnShot(ShotClass, Location, Rotation);
+		if (!Shot)
+		{
+			return nullptr;
+		}
+
+		PoolMisses++;
+		INC_DWORD_STAT(STAT_FlybotShotPoolMisses);
+	}
+
+	Shot->ActivateShot(Location, Rotation, ShotInstigator);
+	LiveShots++;
+	INC_DWORD_STAT(STAT_FlybotLiveShots);
+	return Shot;
+}
+
+void UFlybotShotPool::ReleaseShot(AFlybotShot* Shot)
+{
+	if (!IsValid(Shot) || !Shot->IsShotActive())
+	{
+		return;
+	}
+
+	Shot->DeactivateShot();
+	LiveShots--;
+	DEC_DWORD_STAT(STAT_FlybotLiveShots);
+	Pools.FindOrAdd(Shot->GetClass()).FreeShots.Add(Shot);
+}
+
+AFlybotShot* UFlybotShotPool::SpawnShot(TSubclassOf<AFlybotShot> ShotClass,
+	const FVector& Location, const FRotator& Rotation)
+{
+	AFlybotShot* Shot = GetWorld()->SpawnActor<AFlybotShot>(ShotClass, Location, Rotation);
+	if (Shot)
+	{
+		PoolSize++;
+		INC_DWORD_STAT(STAT_FlybotShotPoolSize);
+	}
+
+	return Shot;
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "FlybotShotPool.generated.h"
+
+/** Inactive shot actors waiting to be handed out for one shot class. */
+USTRUCT()
+struct FFlybotShotPoolEntry
+{
+	GENERATED_BODY()
+
+	/** Shots that are hidden, not moving, and ready to be activated. */
+	UPROPERTY()
+	TArray<class AFlybotShot*> FreeShots;
+
+	/** Whether the pool was already prewarmed, pawns spawning later don't add more shots. */
+	bool bPrewarmed;
+
+	FFlybotShotPoolEntry();
+};
+
+UCLASS()
+class FLYBOT_API UFlybotShotPool : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	UFlybotShotPool();
+
+	/** Dedicated servers simulate shots without actors, see UFlybotProjectileManager. */
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+
+	/** Only pool shots in worlds where gameplay actually runs. */
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	/** Log pool usage so the pool size can be tuned per map. */
+	virtual void Deinitialize() override;
+
+	/**
+	 * Spawn inactive shots of ShotClass until Count are free, so they don't need to be spawned while
+	 * shooting. Only the first call for each class does anything, since pawns are spawned again every
+	 * time they become relevant.
+	 */
+	void Prewarm(TSubclassOf<class AFlybotShot> ShotClass, int32 Count);
+
+	/** Activate a shot from the pool, spawning a new one if none are free. */
+	class AFlybotShot* AcquireShot(TSubclassOf<class AFlybotShot> ShotClass,
+		const FVector& Location, const FRotator& Rotation, class APawn* ShotInstigator);
+
+	/** Deactivate a shot and return it to the pool. */
+	void ReleaseShot(class AFlybotShot* Shot);
+
+	/** How many shots were handed out from the pool without spawning. */
+	uint32 GetPoolHits() const { return PoolHits; }
+
+	/** How many shots had to be spawned because the pool was empty. */
+	uint32 GetPoolMisses() const { return PoolMisses; }
+
+private:
+	/** Spawn a new shot actor for the pool. */
+	class AFlybotShot* SpawnShot(TSubclassOf<class AFlybotShot> ShotClass,
+		const FVector& Location, const FRotator& Rotation);
+
+	/** Free shots for each shot class. */
+	UPROPERTY()
+	TMap<UClass*, FFlybotShotPoolEntry> Pools;
+
+	/** Number of shots handed out from the pool. */
+	uint32 PoolHits;
+
+	/** Number of shots spawned because the pool was empty. */
+	uint32 PoolMisses;
+
+	/** Number of shots spawned for the pool in total. */
+	uint32 PoolSize;
+
+	/** Number of shots handed out and not released yet. */
+	uint32 LiveShots;
+};
\ No newline at end of file
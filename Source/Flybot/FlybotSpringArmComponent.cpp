@@ -0,0 +1,31 @@
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+#include "FlybotSpringArmComponent.h"
+#include "FlybotMapGeometry.h"
+
+void UFlybotSpringArmComponent::UpdateDesiredArmLocation(bool bDoTrace, bool bDoLocationLag,
+	bool bDoRotationLag, float DeltaTime)
+{
+	const UFlybotMapGeometry* MapGeometry = GetWorld()->GetSubsystem<UFlybotMapGeometry>();
+	if (!bDoTrace || !MapGeometry || !MapGeometry->IsEnabled())
+	{
+		Super::UpdateDesiredArmLocation(bDoTrace, bDoLocationLag, bDoRotationLag, DeltaTime);
+		return;
+	}
+
+	// Let the spring arm place the socket with lag but no probe, then pull it in from the arm origin.
+	Super::UpdateDesiredArmLocation(false, bDoLocationLag, bDoRotationLag, DeltaTime);
+
+	FVector ArmOrigin = GetComponentLocation() + TargetOffset;
+	FVector DesiredLocation = GetComponentTransform().TransformPosition(RelativeSocketLocation);
+
+	FFlybotMapHit Hit;
+	bIsCameraFixed = MapGeometry->SweepSphere(ArmOrigin, DesiredLocation, ProbeSize, Hit);
+	UnfixedCameraPosition = DesiredLocation;
+
+	if (bIsCameraFixed)
+	{
+		RelativeSocketLocation = GetComponentTransform().InverseTransformPosition(Hit.Location);
+		UpdateChildTransforms();
+	}
+}
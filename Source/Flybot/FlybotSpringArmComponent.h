@@ -0,0 +1,21 @@
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/SpringArmComponent.h"
+#include "FlybotSpringArmComponent.generated.h"
+
+/**
+ * Spring arm that can probe for walls with the analytic map geometry instead of a physics sweep,
+ * see Flybot.AnalyticMapCollision.
+ */
+UCLASS()
+class FLYBOT_API UFlybotSpringArmComponent : public USpringArmComponent
+{
+	GENERATED_BODY()
+
+protected:
+	/** Pull the arm in with an analytic sweep when enabled, otherwise use the physics probe. */
+	virtual void UpdateDesiredArmLocation(bool bDoTrace, bool bDoLocationLag, bool bDoRotationLag, float DeltaTime) override;
+};
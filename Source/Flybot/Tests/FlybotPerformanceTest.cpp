@@ -0,0 +1,183 @@
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+#include "FlybotPerformanceTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "Flybot.h"
+#include "Dom/JsonObject.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/App.h"
+#include "Misc/CommandLine.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "UObject/UObjectGlobals.h"
+
+static TAutoConsoleVariable<float> CVarFlybotPerformanceTestThreshold(
+	TEXT("Flybot.PerformanceTest.Threshold"),
+	0.2f,
+	TEXT("How much slower than the baseline a performance test result can be before failing, 0.2 for 20%."));
+
+/** Untimed calls before each benchmark. */
+static constexpr int32 WarmupIterations = 3;
+
+FFlybotTestWorld::FFlybotTestWorld()
+{
+	World = UWorld::CreateWorld(EWorldType::Game, false, TEXT("FlybotTestWorld"));
+	FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+	WorldContext.SetCurrentWorld(World);
+
+	World->InitializeActorsForPlay(FURL());
+	World->BeginPlay();
+}
+
+FFlybotTestWorld::~FFlybotTestWorld()
+{
+	GEngine->DestroyWorldContext(World);
+	World->DestroyWorld(false);
+	CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+}
+
+FFlybotPerformanceReport::FFlybotPerformanceReport(FAutomationTestBase& InTest, const FString& InTestName)
+	: Test(InTest), TestName(InTestName)
+{
+}
+
+void FFlybotPerformanceReport::Measure(const FString& Name, int32 Iterations, TFunctionRef<void(int32)> Body)
+{
+	for (int32 Iteration = 0; Iteration < WarmupIterations; Iteration++)
+	{
+		Body(Iteration);
+	}
+
+	double StartTime = FPlatformTime::Seconds();
+	for (int32 Iteration = 0; Iteration < Iterations; Iteration++)
+	{
+		Body(Iteration);
+	}
+
+	AddResult(Name, Iterations, FPlatformTime::Seconds() - StartTime);
+}
+
+void FFlybotPerformanceReport::AddResult(const FString& Name, int32 Iterations, double Seconds)
+{
+	FResult& Result = Results.AddDefaulted_GetRef();
+	Result.Name = TestName + TEXT(".") + Name;
+	Result.Iterations = Iterations;
+	Result.Seconds = Seconds;
+}
+
+void FFlybotPerformanceReport::Finish()
+{
+	FString BaselinePath = FPaths::ProjectDir() / TEXT("Tests/FlybotPerformanceBaseline.json");
+	FParse::Value(FCommandLine::Get(), TEXT("FlybotBaseline="), BaselinePath);
+	float Threshold = CVarFlybotPerformanceTestThreshold.GetValueOnGameThread();
+	bool bUpdateBaseline = FParse::Param(FCommandLine::Get(), TEXT("FlybotUpdateBaseline"));
+	TMap<FString, double> Baseline = LoadBaseline(BaselinePath);
+
+	for (const FResult& Result : Results)
+	{
+		double Microseconds = Result.GetMicroseconds();
+		const double* BaselineMicroseconds = Baseline.Find(Result.Name);
+		if (!BaselineMicroseconds || *BaselineMicroseconds <= 0.0)
+		{
+			// Without a baseline nothing is compared, so make sure that shows up in the report.
+			FString Message = FString::Printf(TEXT("%s: %.3fus, no baseline in %s"), *Result.Name, Microseconds,
+				*BaselinePath);
+			if (bUpdateBaseline)
+			{
+				Test.AddInfo(Message);
+			}
+			else
+			{
+				Test.AddWarning(Message);
+			}
+			continue;
+		}
+
+		double Change = Microseconds / *BaselineMicroseconds - 1.0;
+		FString Message = FString::Printf(TEXT("%s: %.3fus, baseline %.3fus, %+.1f%%"),
+			*Result.Name, Microseconds, *BaselineMicroseconds, Change * 100.0);
+		if (Change > Threshold)
+		{
+			Test.AddError(Message);
+		}
+		else
+		{
+			Test.AddInfo(Message);
+		}
+	}
+
+	SaveResults(FPaths::ProjectSavedDir() / TEXT("Automation/FlybotPerformance") / (TestName + TEXT(".json")));
+	if (bUpdateBaseline)
+	{
+		SaveResults(BaselinePath);
+	}
+}
+
+TMap<FString, double> FFlybotPerformanceReport::LoadBaseline(const FString& Path) const
+{
+	TMap<FString, double> Baseline;
+	FString Json;
+	TSharedPtr<FJsonObject> Root;
+	if (!FFileHelper::LoadFileToString(Json, *Path) ||
+		!FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(Json), Root) || !Root.IsValid())
+		return Baseline;
+
+	const TSharedPtr<FJsonObject>* Entries;
+	if (Root->TryGetObjectField(TEXT("Results"), Entries))
+	{
+		for (const TPair<FString, TSharedPtr<FJsonValue>>& Entry : (*Entries)->Values)
+		{
+			const TSharedPtr<FJsonObject>* Result;
+			if (Entry.Value->TryGetObject(Result))
+			{
+				Baseline.Add(Entry.Key, (*Result)->GetNumberField(TEXT("Microseconds")));
+			}
+		}
+	}
+
+	return Baseline;
+}
+
+void FFlybotPerformanceReport::SaveResults(const FString& Path) const
+{
+	// Keep results for other tests when several tests share the file.
+	FString Json;
+	TSharedPtr<FJsonObject> Root;
+	if (!FFileHelper::LoadFileToString(Json, *Path) ||
+		!FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(Json), Root) || !Root.IsValid())
+	{
+		Root = MakeShared<FJsonObject>();
+	}
+
+	const TSharedPtr<FJsonObject>* ExistingEntries;
+	TSharedPtr<FJsonObject> Entries = Root->TryGetObjectField(TEXT("Results"), ExistingEntries) ?
+		*ExistingEntries : MakeShared<FJsonObject>();
+
+	for (const FResult& Result : Results)
+	{
+		TSharedPtr<FJsonObject> Entry = MakeShared<FJsonObject>();
+		Entry->SetNumberField(TEXT("Iterations"), Result.Iterations);
+		Entry->SetNumberField(TEXT("Seconds"), Result.Seconds);
+		Entry->SetNumberField(TEXT("Microseconds"), Result.GetMicroseconds());
+		Entries->SetObjectField(Result.Name, Entry);
+	}
+
+	Root->SetObjectField(TEXT("Results"), Entries);
+	Root->SetStringField(TEXT("Platform"), FPlatformProperties::IniPlatformName());
+	Root->SetStringField(TEXT("Configuration"), LexToString(FApp::GetBuildConfiguration()));
+
+	Json.Reset();
+	FJsonSerializer::Serialize(Root.ToSharedRef(), TJsonWriterFactory<>::Create(&Json));
+	if (!FFileHelper::SaveStringToFile(Json, *Path))
+	{
+		Test.AddWarning(FString::Printf(TEXT("Could not write performance results to %s"), *Path));
+	}
+}
+
+#endif
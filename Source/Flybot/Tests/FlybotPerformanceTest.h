@@ -0,0 +1,66 @@
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+/** Game world for a test to spawn actors in, destroyed when this goes out of scope. */
+class FFlybotTestWorld
+{
+public:
+	FFlybotTestWorld();
+	~FFlybotTestWorld();
+
+	UWorld* GetWorld() const { return World; }
+
+private:
+	UWorld* World;
+};
+
+/**
+ * Times benchmarks for one performance test, writes the results to Saved/Automation/FlybotPerformance
+ * as JSON, and fails the test when a result is slower than its baseline by more than the threshold
+ * in Flybot.PerformanceTest.Threshold. Results without a baseline are reported as warnings. Baselines
+ * are read from Tests/FlybotPerformanceBaseline.json in the project directory, and running with
+ * -FlybotUpdateBaseline writes the current results there.
+ */
+class FFlybotPerformanceReport
+{
+public:
+	FFlybotPerformanceReport(FAutomationTestBase& InTest, const FString& InTestName);
+
+	/** Time Iterations calls to Body, after a few untimed calls to warm up caches. */
+	void Measure(const FString& Name, int32 Iterations, TFunctionRef<void(int32)> Body);
+
+	/** Add a result timed by the test itself. */
+	void AddResult(const FString& Name, int32 Iterations, double Seconds);
+
+	/** Write the results and compare them with the baseline. */
+	void Finish();
+
+private:
+	/** Time for one benchmark. */
+	struct FResult
+	{
+		FString Name;
+		int32 Iterations;
+		double Seconds;
+
+		double GetMicroseconds() const { return Iterations > 0 ? Seconds * 1000000.0 / Iterations : 0.0; }
+	};
+
+	/** Load the baseline microseconds for each result name. */
+	TMap<FString, double> LoadBaseline(const FString& Path) const;
+
+	/** Write results to a JSON file, merging with any results from other tests already in it. */
+	void SaveResults(const FString& Path) const;
+
+	FAutomationTestBase& Test;
+	FString TestName;
+	TArray<FResult> Results;
+};
+
+#endif
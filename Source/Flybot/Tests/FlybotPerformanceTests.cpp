@@ -0,0 +1,282 @@
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+#include "FlybotPerformanceTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "FlybotAttributeComponent.h"
+#include "FlybotMapRoom.h"
+#include "FlybotMoveValidator.h"
+#include "FlybotPlayerPawn.h"
+#include "FlybotProjectileManager.h"
+#include "FlybotShot.h"
+#include "FlybotShotPool.h"
+#include "Engine/World.h"
+
+/*
+* Run from the command line with:
+* UnrealEditor Flybot.uproject -ExecCmds="Automation RunTests Flybot.Performance; Quit" -nullrhi -nosound -unattended
+*/
+
+static constexpr EAutomationTestFlags::Type PerformanceTestFlags = EAutomationTestFlags::EditorContext |
+	EAutomationTestFlags::ClientContext | EAutomationTestFlags::ServerContext | EAutomationTestFlags::PerfFilter;
+
+/** Pawn internals the tests drive directly instead of going through input and RPCs. */
+struct FFlybotPawnTestAccess
+{
+	/** Shoot every time TryShooting is called without running out of power. */
+	static void StartShooting(AFlybotPlayerPawn* Pawn)
+	{
+		Pawn->bShooting = true;
+		Pawn->ShootingInterval = 0.f;
+		Pawn->Attributes->InitAttribute(EFlybotAttribute::Power, TNumericLimits<float>::Max(), 0.f);
+	}
+
+	static void TryShooting(AFlybotPlayerPawn* Pawn)
+	{
+		Pawn->TryShooting();
+	}
+
+	static void UpdateServerTransform(AFlybotPlayerPawn* Pawn, const FFlybotMovePacket& Packet)
+	{
+		Pawn->UpdateServerTransform_Implementation(Packet);
+	}
+
+	static float GetHealth(const AFlybotPlayerPawn* Pawn)
+	{
+		return Pawn->Attributes->GetValue(EFlybotAttribute::Health);
+	}
+
+	static uint16 GetAckedMoveSequence(const AFlybotPlayerPawn* Pawn)
+	{
+		return Pawn->AckedMoveSequence;
+	}
+
+	static uint8 GetCorrectionId(const AFlybotPlayerPawn* Pawn)
+	{
+		return Pawn->MoveCorrection.Id;
+	}
+};
+
+/** Spawn pawns in a line far enough apart that they don't overlap. */
+static TArray<AFlybotPlayerPawn*> SpawnPawns(UWorld* World, int32 Count)
+{
+	TArray<AFlybotPlayerPawn*> Pawns;
+	for (int32 Index = 0; Index < Count; Index++)
+	{
+		Pawns.Add(World->SpawnActor<AFlybotPlayerPawn>(FVector(Index * 1000.f, 0.f, 0.f), FRotator::ZeroRotator));
+	}
+
+	return Pawns;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFlybotMapRoomConstructionTest, "Flybot.Performance.MapRoomConstruction",
+	PerformanceTestFlags)
+
+bool FFlybotMapRoomConstructionTest::RunTest(const FString& Parameters)
+{
+	FFlybotTestWorld TestWorld;
+	UWorld* World = TestWorld.GetWorld();
+	FFlybotPerformanceReport Report(*this, TEXT("MapRoomConstruction"));
+
+	const uint32 RoomSizes[] = { 1, 5, 11 };
+	const uint32 TubeSizes[] = { 0, 4, 16 };
+	const int32 Iterations = 10;
+
+	for (uint32 RoomSize : RoomSizes)
+	{
+		for (uint32 TubeSize : TubeSizes)
+		{
+			// Only time construction, spawning and destroying the actor is the same for every room.
+			double Seconds = 0.0;
+			for (int32 Iteration = 0; Iteration < Iterations; Iteration++)
+			{
+				AFlybotMapRoom* Room = World->SpawnActorDeferred<AFlybotMapRoom>(AFlybotMapRoom::StaticClass(),
+					FTransform::Identity);
+				Room->RoomSize = RoomSize;
+				Room->PositiveXTubeSize = TubeSize;
+				Room->NegativeXTubeSize = TubeSize;
+				Room->PositiveYTubeSize = TubeSize;
+				Room->NegativeYTubeSize = TubeSize;
+				Room->PositiveZTubeSize = TubeSize;
+				Room->NegativeZTubeSize = TubeSize;
+
+				double StartTime = FPlatformTime::Seconds();
+				Room->FinishSpawning(FTransform::Identity);
+				Seconds += FPlatformTime::Seconds() - StartTime;
+
+				Room->Destroy();
+			}
+
+			Report.AddResult(FString::Printf(TEXT("Room%d.Tubes%d"), RoomSize, TubeSize), Iterations, Seconds);
+		}
+	}
+
+	Report.Finish();
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFlybotShotTest, "Flybot.Performance.Shots", PerformanceTestFlags)
+
+bool FFlybotShotTest::RunTest(const FString& Parameters)
+{
+	FFlybotTestWorld TestWorld;
+	UWorld* World = TestWorld.GetWorld();
+	FFlybotPerformanceReport Report(*this, TEXT("Shots"));
+
+	TArray<AFlybotPlayerPawn*> Pawns = SpawnPawns(World, 2);
+	AFlybotPlayerPawn* Shooter = Pawns[0];
+	AFlybotPlayerPawn* Target = Pawns[1];
+	FFlybotPawnTestAccess::StartShooting(Shooter);
+
+	// Dedicated servers simulate shots in the projectile manager, everything else activates pooled actors.
+	UFlybotProjectileManager* ProjectileManager = World->GetSubsystem<UFlybotProjectileManager>();
+	UFlybotShotPool* ShotPool = World->GetSubsystem<UFlybotShotPool>();
+	if (!TestTrue(TEXT("Projectile manager or shot pool"), ProjectileManager || ShotPool))
+		return false;
+
+	uint32 PooledShots = ShotPool ? ShotPool->GetPoolHits() + ShotPool->GetPoolMisses() : 0;
+	Report.Measure(TEXT("TryShooting"), 1000, [Shooter](int32)
+	{
+		FFlybotPawnTestAccess::TryShooting(Shooter);
+	});
+
+	// Timing is meaningless if TryShooting returned early, so make sure every call fired a shot.
+	int32 NumShots = ProjectileManager ? ProjectileManager->GetNumShots() :
+		int32(ShotPool->GetPoolHits() + ShotPool->GetPoolMisses() - PooledShots);
+	TestTrue(TEXT("Shots fired"), NumShots >= 1000);
+
+	// Shots fly along X straight at the target, so the manager ticks should hit it.
+	float TargetHealth = FFlybotPawnTestAccess::GetHealth(Target);
+	if (ProjectileManager)
+	{
+		Report.Measure(TEXT("ProjectileManagerTick"), 100, [ProjectileManager](int32)
+		{
+			ProjectileManager->Tick(1.f / 30.f);
+		});
+
+		TestTrue(TEXT("Simulated shots hit the target"), FFlybotPawnTestAccess::GetHealth(Target) < TargetHealth);
+	}
+	else
+	{
+		UPrimitiveComponent* TargetComponent = Cast<UPrimitiveComponent>(Target->GetRootComponent());
+		Report.Measure(TEXT("OnHit"), 1000, [ShotPool, Shooter, Target, TargetComponent](int32)
+		{
+			AFlybotShot* Shot = ShotPool->AcquireShot(AFlybotShot::StaticClass(), Target->GetActorLocation(),
+				FRotator::ZeroRotator, Shooter);
+			Shot->OnHit(Shot->Collision, Target, TargetComponent, FVector::ZeroVector, FHitResult());
+		});
+
+		TestTrue(TEXT("Pooled shots hit the target"), FFlybotPawnTestAccess::GetHealth(Target) < TargetHealth);
+	}
+
+	Report.Finish();
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFlybotServerMoveTest, "Flybot.Performance.ServerMoves", PerformanceTestFlags)
+
+bool FFlybotServerMoveTest::RunTest(const FString& Parameters)
+{
+	FFlybotTestWorld TestWorld;
+	UWorld* World = TestWorld.GetWorld();
+	FFlybotPerformanceReport Report(*this, TEXT("ServerMoves"));
+
+	AFlybotPlayerPawn* Pawn = SpawnPawns(World, 1)[0];
+	UFlybotMoveValidator* MoveValidator = World->GetSubsystem<UFlybotMoveValidator>();
+	if (!TestNotNull(TEXT("MoveValidator"), MoveValidator))
+		return false;
+
+	// Build packets the same way the client does, two moves per packet at 60 saved moves and 30
+	// packets a second. Moves are slow enough to pass the speed check, so no corrections are sent.
+	FFlybotMoveHistory ClientHistory;
+	uint16 Sequence = 0;
+	uint16 AckedSequence = 0;
+	float Timestamp = 0.f;
+	FVector Position = FVector::ZeroVector;
+	auto MakePacket = [&]()
+	{
+		FFlybotMovePacket Packet;
+		const FVector* BasePosition = ClientHistory.Find(AckedSequence);
+		Packet.bAbsolute = BasePosition == nullptr;
+		Packet.BaseSequence = AckedSequence;
+
+		FVector PreviousPosition = BasePosition ? *BasePosition : FVector::ZeroVector;
+		for (int32 Move = 0; Move < 2; Move++)
+		{
+			Timestamp += 1.f / 60.f;
+			Position = FFlybotMovePacket::QuantizePosition(Position + FVector(10.f, 0.f, 0.f));
+
+			FFlybotSavedMove SavedMove;
+			SavedMove.Sequence = ++Sequence;
+			SavedMove.Timestamp = Timestamp;
+			SavedMove.Position = Position;
+			ClientHistory.Add(SavedMove.Sequence, SavedMove.Position);
+			Packet.AddMove(SavedMove, PreviousPosition);
+			PreviousPosition = Position;
+		}
+
+		AckedSequence = Sequence;
+		return Packet;
+	};
+
+	const int32 Iterations = 2000;
+	double ReceiveSeconds = 0.0;
+	double ValidateSeconds = 0.0;
+	for (int32 Iteration = 0; Iteration < Iterations; Iteration++)
+	{
+		FFlybotMovePacket Packet = MakePacket();
+
+		double StartTime = FPlatformTime::Seconds();
+		FFlybotPawnTestAccess::UpdateServerTransform(Pawn, Packet);
+		double ReceiveTime = FPlatformTime::Seconds();
+		MoveValidator->Tick(1.f / 30.f);
+
+		ReceiveSeconds += ReceiveTime - StartTime;
+		ValidateSeconds += FPlatformTime::Seconds() - ReceiveTime;
+	}
+
+	// An early return in either step would also look fast, so check every move was accepted and applied.
+	TestEqual(TEXT("Acked move sequence"), FFlybotPawnTestAccess::GetAckedMoveSequence(Pawn), Sequence);
+	TestEqual(TEXT("Corrections sent"), FFlybotPawnTestAccess::GetCorrectionId(Pawn), uint8(0));
+	TestTrue(TEXT("Pawn moved to the last move"), Pawn->GetCollisionBounds().Origin.Equals(Position, 1.f));
+
+	Report.AddResult(TEXT("UpdateServerTransform"), Iterations, ReceiveSeconds);
+	Report.AddResult(TEXT("ValidateAndApply"), Iterations, ValidateSeconds);
+	Report.Finish();
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFlybotPawnTickTest, "Flybot.Performance.PawnTick", PerformanceTestFlags)
+
+bool FFlybotPawnTickTest::RunTest(const FString& Parameters)
+{
+	FFlybotTestWorld TestWorld;
+	UWorld* World = TestWorld.GetWorld();
+	FFlybotPerformanceReport Report(*this, TEXT("PawnTick"));
+
+	const int32 PawnCounts[] = { 1, 16, 64, 128 };
+	for (int32 PawnCount : PawnCounts)
+	{
+		TArray<AFlybotPlayerPawn*> Pawns = SpawnPawns(World, PawnCount);
+
+		// One iteration is one frame of ticking every pawn.
+		Report.Measure(FString::Printf(TEXT("Pawns%d"), PawnCount), 100, [&Pawns](int32)
+		{
+			for (AFlybotPlayerPawn* Pawn : Pawns)
+			{
+				Pawn->Tick(1.f / 30.f);
+			}
+		});
+
+		for (AFlybotPlayerPawn* Pawn : Pawns)
+		{
+			Pawn->Destroy();
+		}
+	}
+
+	Report.Finish();
+	return true;
+}
+
+#endif
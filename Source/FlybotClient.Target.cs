@@ -9,6 +9,7 @@ public class FlybotClientTarget : TargetRules
 	{
 		Type = TargetType.Client;
 		DefaultBuildSettings = BuildSettingsVersion.V2;
+		bWithPushModel = true;
 		ExtraModuleNames.AddRange( new string[] { "Flybot" } );
 	}
 }